@@ -0,0 +1,60 @@
+#include <algorithm>
+#include "BarGrid.h"
+using namespace std;
+namespace MusicCodes {
+	BarGrid::BarGrid(const vector<MidiReader::TimeSignatureChange>& timeSignatures, unsigned int ticksPerQuarterNote){
+		// Every beat must be at least one tick long.
+		ticksPerQuarterNote = max(ticksPerQuarterNote, 1u);
+		// Start in 4/4 time in case the first time signature is not at the beginning.
+		sections.push_back({0, 1, ticksPerQuarterNote, 4});
+		for(const auto& change : timeSignatures){
+			const Section& last = sections.back();
+			// The beat is the note in the denominator of the time signature.
+			// For example, the beat of 6/8 is an eighth note, which is half of a quarter note.
+			// The denominator comes straight from the file, so check it before shifting by it.
+			int beatsPerBar = change.timeSignature.getNumerator();
+			if(change.timeSignature.getDenominatorLog2() > MAX_DENOMINATOR_LOG2 || beatsPerBar <= 0){
+				// This time signature makes no sense, so keep the last one.
+				continue;
+			}
+			int64_t ticksPerBeat = (int64_t)ticksPerQuarterNote * 4 >> change.timeSignature.getDenominatorLog2();
+			if(ticksPerBeat <= 0){
+				// The beat is shorter than a tick.
+				continue;
+			}
+			// Count the bars of the last section, including one that was cut short by this change.
+			int64_t ticksPerBar = last.ticksPerBeat * last.beatsPerBar;
+			int64_t firstBar = last.firstBar + (change.tick - last.tick + ticksPerBar - 1) / ticksPerBar;
+			if(change.tick == last.tick){
+				// The last section never got a bar, so this one replaces it.
+				firstBar = last.firstBar;
+				sections.pop_back();
+			}
+			sections.push_back({change.tick, firstBar, ticksPerBeat, beatsPerBar});
+		}
+	}
+	int64_t BarGrid::getBarStart(int64_t bar) const {
+		return getBeatStart(bar, 1);
+	}
+	int64_t BarGrid::getBeatStart(int64_t bar, int beat) const {
+		const Section& section = findSectionOfBar(bar);
+		return section.tick + ((bar - section.firstBar) * section.beatsPerBar + beat - 1) * section.ticksPerBeat;
+	}
+	void BarGrid::locate(int64_t tick, int64_t& bar, int& beat) const {
+		// Find the last section that starts at or before the tick.
+		auto after = upper_bound(sections.begin(), sections.end(), tick, [](int64_t t, const Section& s){
+			return t < s.tick;
+		});
+		const Section& section = after == sections.begin() ? *after : *(after - 1);
+		int64_t beats = (tick - section.tick) / section.ticksPerBeat;
+		bar = section.firstBar + beats / section.beatsPerBar;
+		beat = beats % section.beatsPerBar + 1;
+	}
+	const BarGrid::Section& BarGrid::findSectionOfBar(int64_t bar) const {
+		// Find the last section that starts at or before the bar.
+		auto after = upper_bound(sections.begin(), sections.end(), bar, [](int64_t b, const Section& s){
+			return b < s.firstBar;
+		});
+		return after == sections.begin() ? *after : *(after - 1);
+	}
+}
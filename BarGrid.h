@@ -0,0 +1,41 @@
+/*
+	This class shall lay out the bars and beats of a piece of music in MIDI
+	ticks, using the time signatures of the MIDI file.
+
+	A time signature change always starts a new bar, even if the last bar was
+	not finished. If the file has no time signature at tick 0, the piece starts
+	in 4/4 time. Bars and beats are numbered from 1, like in sheet music.
+*/
+#ifndef INCLUDE_MUSIC_CODES_BARGRID
+#define INCLUDE_MUSIC_CODES_BARGRID 1
+#include <cstdint>
+#include <vector>
+#include "MidiReader.h"
+namespace MusicCodes {
+	class BarGrid {
+	public:
+		BarGrid(const std::vector<MidiReader::TimeSignatureChange>& timeSignatures, unsigned int ticksPerQuarterNote);
+		// Returns the tick at which a bar starts.
+		int64_t getBarStart(int64_t bar) const;
+		// Returns the tick at which a beat of a bar starts.
+		int64_t getBeatStart(int64_t bar, int beat) const;
+		// Finds the bar and the beat that a tick is in.
+		void locate(int64_t tick, int64_t& bar, int& beat) const;
+		// Time signatures with a denominator above 2^6 (a 64th note) are ignored.
+		static constexpr int MAX_DENOMINATOR_LOG2 = 6;
+	private:
+		// A stretch of bars that all have the same time signature
+		struct Section {
+			// The tick at which the first bar of this section starts
+			int64_t tick;
+			// The number of the first bar of this section
+			int64_t firstBar;
+			int64_t ticksPerBeat;
+			int beatsPerBar;
+		};
+		std::vector<Section> sections;
+		// Returns the section that contains the bar.
+		const Section& findSectionOfBar(int64_t bar) const;
+	};
+}
+#endif
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <cctype>
+#include <dirent.h>
+#include <iostream>
+#include <sys/stat.h>
+#include "FileList.h"
+using namespace std;
+namespace MusicCodes {
+	void findFiles(const string& path, vector<string>& files){
+		struct stat st;
+		if(stat(path.c_str(), &st) != 0){
+			cerr << path << ": This file could not be opened.\n";
+			return;
+		}
+		if(!S_ISDIR(st.st_mode)){
+			files.push_back(path);
+			return;
+		}
+		DIR* directory = opendir(path.c_str());
+		if(!directory){
+			cerr << path << ": This directory could not be opened.\n";
+			return;
+		}
+		vector<string> children;
+		while(dirent* entry = readdir(directory)){
+			string name = entry->d_name;
+			if(name == "." || name == ".."){
+				continue;
+			}
+			string child = path + '/' + name;
+			if(entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))){
+				findFiles(child, files);
+				continue;
+			}
+			// Inside of directories, only look at files that are named like MIDI files.
+			size_t dot = name.rfind('.');
+			if(dot != string::npos){
+				string extension = name.substr(dot + 1);
+				for(char& c : extension){
+					c = tolower(c);
+				}
+				if(extension == "mid" || extension == "midi"){
+					children.push_back(child);
+				}
+			}
+		}
+		closedir(directory);
+		sort(children.begin(), children.end());
+		files.insert(files.end(), children.begin(), children.end());
+	}
+}
@@ -0,0 +1,19 @@
+/*
+	This function shall gather the MIDI files that the programs were asked to
+	read, so that a whole corpus can be passed in as a directory.
+
+	Paths to files are always kept, whatever they are named. Directories are
+	searched recursively for files that end in .mid or .midi, and the files in
+	each directory are sorted by name so that the order is the same from run to
+	run.
+*/
+#ifndef INCLUDE_MUSIC_CODES_FILELIST
+#define INCLUDE_MUSIC_CODES_FILELIST 1
+#include <string>
+#include <vector>
+namespace MusicCodes {
+	// Adds the path to the list if it is a file, or every MIDI file under it if it is a directory.
+	// Paths that cannot be opened are reported on cerr and skipped.
+	void findFiles(const std::string& path, std::vector<std::string>& files);
+}
+#endif
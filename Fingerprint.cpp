@@ -0,0 +1,94 @@
+#include <algorithm>
+#include "Fingerprint.h"
+using namespace std;
+namespace {
+	// Mixes the bits of x so that similar inputs give very different outputs (splitmix64).
+	uint64_t mix(uint64_t x){
+		x += 0x9E3779B97F4A7C15;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+		return x ^ (x >> 31);
+	}
+	// The multipliers and offsets of the hash functions. Hash function i maps a shingle hash x
+	// to the upper 32 bits of MULTIPLIERS[i] * x + OFFSETS[i].
+	struct HashFunctions {
+		uint64_t multipliers[MusicCodes::Fingerprint::NUM_HASHES];
+		uint64_t offsets[MusicCodes::Fingerprint::NUM_HASHES];
+		HashFunctions(){
+			for(int i = 0; i < MusicCodes::Fingerprint::NUM_HASHES; ++i){
+				// Multipliers must be odd.
+				multipliers[i] = mix(2 * i) | 1;
+				offsets[i] = mix(2 * i + 1);
+			}
+		}
+	};
+	const HashFunctions HASH_FUNCTIONS;
+	// The base of the rolling hash
+	const uint64_t ROLLING_BASE = 0x100000001B3;
+	// Keeps a value between the lowest and highest values.
+	int clamp(int value, int lowest, int highest){
+		return value < lowest ? lowest : value > highest ? highest : value;
+	}
+}
+namespace MusicCodes {
+	Fingerprint::Fingerprint(vector<Note> notes) : valid(false) {
+		fill(signature, signature + NUM_HASHES, UINT32_MAX);
+		if(notes.size() <= SHINGLE_LENGTH){
+			return;
+		}
+		// Put the notes in the order that they are played. The tracks of a multi-track file come
+		// one after another, and the notes of a chord come from lowest to highest.
+		sort(notes.begin(), notes.end(), [](const Note& lhs, const Note& rhs){
+			if(lhs.getStartTick() != rhs.getStartTick()){
+				return lhs.getStartTick() < rhs.getStartTick();
+			}
+			return lhs.getPitch() < rhs.getPitch();
+		});
+		// ROLLING_BASE to the power of SHINGLE_LENGTH, for removing the oldest token from the rolling hash
+		uint64_t oldestTokenFactor = 1;
+		for(int i = 0; i < SHINGLE_LENGTH; ++i){
+			oldestTokenFactor *= ROLLING_BASE;
+		}
+		vector<uint64_t> tokens;
+		tokens.reserve(notes.size() - 1);
+		uint64_t rollingHash = 0;
+		for(size_t i = 1; i < notes.size(); ++i){
+			// The token is the interval in half steps and the change in the duration exponent, each in 8 bits.
+			int interval = clamp(notes[i].getPitch() - notes[i - 1].getPitch(), -127, 127);
+			int durationChange = clamp(notes[i].getDuration() - notes[i - 1].getDuration(), -127, 127);
+			uint64_t token = (uint64_t)(uint8_t)interval << 8 | (uint8_t)durationChange;
+			tokens.push_back(token);
+			rollingHash = rollingHash * ROLLING_BASE + token;
+			if(tokens.size() > SHINGLE_LENGTH){
+				rollingHash -= tokens[tokens.size() - 1 - SHINGLE_LENGTH] * oldestTokenFactor;
+			}
+			if(tokens.size() < SHINGLE_LENGTH){
+				continue;
+			}
+			// The rolling hash is only a sum of tokens, so mix it before hashing it again.
+			uint64_t shingle = mix(rollingHash);
+			for(int h = 0; h < NUM_HASHES; ++h){
+				uint32_t value = (HASH_FUNCTIONS.multipliers[h] * shingle + HASH_FUNCTIONS.offsets[h]) >> 32;
+				signature[h] = min(signature[h], value);
+			}
+		}
+		valid = true;
+	}
+	Fingerprint::operator bool() const {
+		return valid;
+	}
+	double Fingerprint::similarity(const Fingerprint& other) const {
+		int equal = 0;
+		for(int h = 0; h < NUM_HASHES; ++h){
+			equal += signature[h] == other.signature[h];
+		}
+		return (double)equal / NUM_HASHES;
+	}
+	uint64_t Fingerprint::getBandHash(int band) const {
+		uint64_t result = mix(band);
+		for(int r = 0; r < ROWS_PER_BAND; ++r){
+			result = mix(result ^ signature[band * ROWS_PER_BAND + r]);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,43 @@
+/*
+	This class shall summarize the notes of a piece of music so that copies of
+	the same piece can be found quickly, even if they were transposed or
+	retimed.
+
+	The notes are turned into tokens made of the pitch interval and the change
+	in duration from one note to the next. Using differences means that a
+	transposed copy gives the same intervals and a copy that was slowed down or
+	sped up by a power of two gives the same duration changes. Every run of
+	SHINGLE_LENGTH tokens (a shingle) is hashed with a rolling hash, and the
+	smallest hash under each of NUM_HASHES hash functions is kept as the MinHash
+	signature. The fraction of equal values in two signatures estimates the
+	Jaccard similarity of the two sets of shingles.
+
+	For locality-sensitive hashing, the signature is split into NUM_BANDS bands.
+	Two fingerprints that have a band in common are candidates for being copies.
+*/
+#ifndef INCLUDE_MUSIC_CODES_FINGERPRINT
+#define INCLUDE_MUSIC_CODES_FINGERPRINT 1
+#include <cstdint>
+#include <vector>
+#include "Note.h"
+namespace MusicCodes {
+	class Fingerprint {
+	public:
+		static constexpr int SHINGLE_LENGTH = 8;
+		static constexpr int NUM_HASHES = 128;
+		static constexpr int NUM_BANDS = 32;
+		static constexpr int ROWS_PER_BAND = NUM_HASHES / NUM_BANDS;
+		// Builds the fingerprint of the notes, which can be in any order.
+		Fingerprint(std::vector<Note> notes);
+		// Whether there were enough notes to make at least one shingle
+		operator bool() const;
+		// Returns the estimated Jaccard similarity of the two pieces, from 0 to 1.
+		double similarity(const Fingerprint&) const;
+		// Returns a hash of the values in one band of the signature.
+		uint64_t getBandHash(int band) const;
+	private:
+		uint32_t signature[NUM_HASHES];
+		bool valid;
+	};
+}
+#endif
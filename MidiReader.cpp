@@ -5,7 +5,8 @@
 using namespace std;
 namespace MusicCodes {
 	// MidiReader
-	MidiReader::MidiReader(istream& input) : input(input), currentTrack(NULL) {
+	MidiReader::MidiReader(istream& input) : input(input), currentTrack(NULL), checkpointInterval(0), seeking(false), seekTick(0), nextSeekTrack(0) {
+		resetTempoMap();
 		// Make sure that this is a MIDI file.
 		midiValid = false;
 		// Read the first four bytes and check for the beginning of a MIDI header chunk.
@@ -26,7 +27,7 @@ namespace MusicCodes {
 					// Get the timing division.
 					midiDivision = getValue<int16_t>();
 					// ...and we're finally done.
-					midiValid = true;
+					midiValid = midiDivision != 0;
 				}
 			}
 		}
@@ -35,34 +36,46 @@ namespace MusicCodes {
 		delete currentTrack;
 	}
 	Note MidiReader::getNextNote(){
-		// If we are not in a track or at the end of the current track, move to the next track.
-		if(!currentTrack || currentTrack->endOfData()){
-			delete currentTrack;
-			while(true){
-				if(!input){
-					// One of the internal state flags of the istream is set. We probably have
-					// reached the end of the file.
-					return Note::InvalidNote();
+		while(true){
+			if(currentTrack){
+				Note n = currentTrack->getNextNote();
+				if(n){
+					return n;
 				}
-				currentTrack = new Track(this);
-				if(currentTrack){
-					break;
-				}else{
-					// It's an alien chunk. Skip it by reading the next four bytes, interpreting
-					// them as the length of this chunk, and then skipping that number of bytes.
-					skipBytes(getValue<uint32_t>());
+				// This track has run out of notes. Some tracks, like the tempo track of a
+				// multi-track file, never had any, so keep going with the next track.
+				delete currentTrack;
+				currentTrack = NULL;
+			}
+			if(seeking){
+				// Resume the tracks that buildCheckpoints() found, one after another.
+				if(nextSeekTrack >= checkpointTable.size()){
+					return Note::InvalidNote();
 				}
+				currentTrack = new Track(this, checkpointTable[nextSeekTrack++]);
+				continue;
+			}
+			if(!input){
+				// One of the internal state flags of the istream is set. We probably have
+				// reached the end of the file.
+				return Note::InvalidNote();
 			}
+			// In multi-song files, every track has its own tempo and time signatures.
+			if(midiFormat == MULTI_SONG){
+				resetTempoMap();
+				timeSignatures.clear();
+			}
+			// Alien chunks are skipped by the Track constructor and simply have no notes.
+			currentTrack = new Track(this);
 		}
-		return currentTrack->getNextNote();
 	}
-	unsigned int MidiReader::getTicksPerQuarterNote(uint32_t microsecondsPerQuarterNote){
+	unsigned int MidiReader::getTicksPerQuarterNote(uint32_t microsecondsPerQuarterNote) const {
 		// If midiDivision is negative, it is in SMPTE format.
 		if(midiDivision < 0){
 			// The upper byte is the negative SMPTE format in two's-complement form.
-			int8_t framesPerSecond = *((int8_t*)&midiDivision);
+			int8_t framesPerSecond = midiDivision >> 8;
 			// The lower byte is the number of ticks per frame.
-			uint8_t ticksPerFrame = *((uint8_t*)&midiDivision + 1);
+			uint8_t ticksPerFrame = midiDivision & 0xFF;
 			// [T/F] * [F/S] = [T/S]
 			// [T/S] / [uS/S] = [T/uS] (this step was moved to the end to improve precision)
 			// [T/uS] * [uS/B] = [T/B]
@@ -71,12 +84,78 @@ namespace MusicCodes {
 		// It's already stored as ticks per quarter note! That makes things easy.
 		return midiDivision;
 	}
+	unsigned int MidiReader::getTicksPerQuarterNoteAt(int64_t tick) const {
+		return getTicksPerQuarterNote(getTempoAt(tick).microsecondsPerQuarterNote);
+	}
+	int64_t MidiReader::ticksToMicroseconds(int64_t tick) const {
+		return ticksToMicroseconds(tick, getTempoAt(tick));
+	}
+	void MidiReader::ticksToMicroseconds(const int64_t* ticks, int64_t* microseconds, size_t count) const {
+		// Start at the first tempo and only search again when a tick falls outside of the current one.
+		size_t current = 0;
+		int64_t currentStart = INT64_MIN;
+		int64_t currentEnd = tempoMap.size() > 1 ? tempoMap[1].tick : INT64_MAX;
+		for(size_t i = 0; i < count; ++i){
+			if(ticks[i] < currentStart || ticks[i] >= currentEnd){
+				auto after = upper_bound(tempoMap.begin(), tempoMap.end(), ticks[i], [](int64_t t, const TempoChange& c){
+					return t < c.tick;
+				});
+				current = after == tempoMap.begin() ? 0 : after - tempoMap.begin() - 1;
+				currentStart = current ? tempoMap[current].tick : INT64_MIN;
+				currentEnd = current + 1 < tempoMap.size() ? tempoMap[current + 1].tick : INT64_MAX;
+			}
+			microseconds[i] = ticksToMicroseconds(ticks[i], tempoMap[current]);
+		}
+	}
 	MidiReader::operator bool() const {
 		return midiValid;
 	}
 	streampos MidiReader::tellg(){
 		return input.tellg();
 	}
+	bool MidiReader::buildCheckpoints(unsigned int intervalTicks){
+		// In multi-song files, every track has its own tempo map, which would be lost by seeking.
+		if(!midiValid || midiFormat == MULTI_SONG || !intervalTicks){
+			return false;
+		}
+		// Go back to the first track and read every track. The Track constructor records the checkpoints.
+		delete currentTrack;
+		currentTrack = NULL;
+		seeking = false;
+		checkpointTable.clear();
+		checkpointInterval = intervalTicks;
+		streampos firstTrack = 8 + (streamoff)lengthMThd;
+		input.clear();
+		input.seekg(firstTrack);
+		while(input){
+			Track t(this);
+		}
+		checkpointInterval = 0;
+		// Go back to the first track again so that getNextNote() starts from the beginning.
+		input.clear();
+		input.seekg(firstTrack);
+		return (bool)input;
+	}
+	bool MidiReader::seekToTick(int64_t tick){
+		if(checkpointTable.empty()){
+			return false;
+		}
+		delete currentTrack;
+		currentTrack = NULL;
+		seeking = true;
+		seekTick = tick;
+		nextSeekTrack = 0;
+		return true;
+	}
+	MidiReader::FORMAT MidiReader::getFormat() const {
+		return midiFormat;
+	}
+	uint16_t MidiReader::getNumTracks() const {
+		return midiNumTracks;
+	}
+	int16_t MidiReader::getDivision() const {
+		return midiDivision;
+	}
 	template <class T>
 	T MidiReader::getValue(){
 		char buffer[sizeof(T)];
@@ -103,7 +182,65 @@ namespace MusicCodes {
 		return result;
 	}
 	void MidiReader::skipBytes(streamoff n){
-		input.seekg(n, ios_base::cur);
+		// Seeking a file stream throws away its buffer and reads it again, so short skips
+		// just read through the bytes that are already in the buffer.
+		if(n >= 0 && n <= 256){
+			input.ignore(n);
+		}else{
+			input.seekg(n, ios_base::cur);
+		}
+	}
+	void MidiReader::addTempoChange(int64_t tick, uint32_t microsecondsPerQuarterNote){
+		// Tempo changes usually come in order, so check the end first.
+		auto position = tempoMap.end();
+		if(tick < tempoMap.back().tick){
+			position = lower_bound(tempoMap.begin(), tempoMap.end(), tick, [](const TempoChange& c, int64_t t){
+				return c.tick < t;
+			});
+		}else if(tick == tempoMap.back().tick){
+			--position;
+		}
+		if(position != tempoMap.end() && position->tick == tick){
+			position->microsecondsPerQuarterNote = microsecondsPerQuarterNote;
+		}else{
+			position = tempoMap.insert(position, {tick, microsecondsPerQuarterNote, 0});
+		}
+		// Recalculate the time of every tempo change from this one onward.
+		for(auto it = position; it != tempoMap.end(); ++it){
+			it->microseconds = it == tempoMap.begin() ? 0 : ticksToMicroseconds(it->tick, *(it - 1));
+		}
+	}
+	const vector<MidiReader::TimeSignatureChange>& MidiReader::getTimeSignatures() const {
+		return timeSignatures;
+	}
+	void MidiReader::addTimeSignature(int64_t tick, const Track::TimeSignature& timeSignature){
+		auto position = upper_bound(timeSignatures.begin(), timeSignatures.end(), tick, [](int64_t t, const TimeSignatureChange& c){
+			return t < c.tick;
+		});
+		if(position != timeSignatures.begin() && (position - 1)->tick == tick){
+			(position - 1)->timeSignature = timeSignature;
+		}else{
+			timeSignatures.insert(position, {tick, timeSignature});
+		}
+	}
+	void MidiReader::resetTempoMap(){
+		// The default tempo is 120 beats per minute.
+		tempoMap.assign(1, {0, 500000, 0});
+	}
+	const MidiReader::TempoChange& MidiReader::getTempoAt(int64_t tick) const {
+		auto after = upper_bound(tempoMap.begin(), tempoMap.end(), tick, [](int64_t t, const TempoChange& c){
+			return t < c.tick;
+		});
+		return after == tempoMap.begin() ? *after : *(after - 1);
+	}
+	int64_t MidiReader::ticksToMicroseconds(int64_t tick, const TempoChange& tempo) const {
+		if(midiDivision < 0){
+			// SMPTE divisions count ticks in real time, so the tempo does not matter.
+			int64_t ticksPerSecond = (int64_t)-(int8_t)(midiDivision >> 8) * (midiDivision & 0xFF);
+			return ticksPerSecond > 0 ? tick * 1000000 / ticksPerSecond : 0;
+		}
+		// Count from the tempo change so that rounding errors do not build up over the whole track.
+		return tempo.microseconds + (tick - tempo.tick) * tempo.microsecondsPerQuarterNote / midiDivision;
 	}
 	ostream& operator<<(ostream& lhs, const MidiReader& rhs){
 		lhs << "<MidiReader: valid=" << rhs.midiValid << ", format=";
@@ -125,14 +262,7 @@ namespace MusicCodes {
 	}
 	// MidiReader::Track
 	MidiReader::Track::Track(MidiReader* file) : file(file), ns(this) {
-		trackValid = false;
-		sawTrackEnd = false;
-		sequenceNumber = 0;
-		lastSeenTempo = 500000;
-		lastSeenTimeSignature = NULL;
-		lastSeenKeySignature = NULL;
-		lastSeenEventType = 0;
-		runningTime = 0;
+		initialize();
 		// Make sure that this is a MIDI track.
 		// Read the first four bytes and check for the beginning of a MIDI track.
 		char buffer[5];
@@ -145,17 +275,41 @@ namespace MusicCodes {
 			// When (file->input.tellg() - streamPositionStart) == lengthMTrk,
 			// we have reached the end of the data for this track.
 			streamPositionStart = file->input.tellg();
+			// If buildCheckpoints() is running, record checkpoints for this track.
+			if(file->checkpointInterval){
+				file->checkpointTable.push_back({streamPositionStart, lengthMTrk, {}});
+				checkpoints = &file->checkpointTable.back();
+			}
 			// Read through the entire track.
-			do {
-				auto e = handleNextEvent();
-				if(e == NUM_EVENTS){
-					// An unknown event was seen.
-					break;
-				}
-			} while(!sawTrackEnd);
-			// Check whether the end of the track was seen.
-			trackValid = sawTrackEnd;
+			readEvents();
+		}else if(file->input){
+			// It's an alien chunk. Skip it by reading the next four bytes, interpreting
+			// them as the length of this chunk, and then skipping that number of bytes.
+			file->skipBytes(file->getValue<uint32_t>());
+		}
+	}
+	MidiReader::Track::Track(MidiReader* file, const TrackCheckpoints& track) : file(file), ns(this) {
+		initialize();
+		streamPositionStart = track.streamPositionStart;
+		lengthMTrk = track.lengthMTrk;
+		// Find the last checkpoint at or before the tick that is being sought.
+		auto after = upper_bound(track.checkpoints.begin(), track.checkpoints.end(), file->seekTick, [](int64_t t, const Checkpoint& c){
+			return t < c.runningTime;
+		});
+		file->input.clear();
+		if(after == track.checkpoints.begin()){
+			// There is no checkpoint early enough, so start from the beginning of the track.
+			file->input.seekg(streamPositionStart);
+		}else{
+			// Put everything back the way that it was at the checkpoint.
+			const Checkpoint& checkpoint = *(after - 1);
+			file->input.seekg(checkpoint.position);
+			lastSeenEventType = checkpoint.lastSeenEventType;
+			runningTime = checkpoint.runningTime;
+			lastSeenTempo = checkpoint.lastSeenTempo;
+			ns.setNotesThatAreOn(checkpoint.notesThatAreOn);
 		}
+		readEvents();
 	}
 	MidiReader::Track::~Track(){
 		delete lastSeenTimeSignature;
@@ -164,6 +318,38 @@ namespace MusicCodes {
 	MidiReader::Track::operator bool() const {
 		return trackValid;
 	}
+	void MidiReader::Track::initialize(){
+		trackValid = false;
+		sawTrackEnd = false;
+		sequenceNumber = 0;
+		lastSeenTempo = 500000;
+		lastSeenTimeSignature = NULL;
+		lastSeenKeySignature = NULL;
+		lastSeenEventType = 0;
+		runningTime = 0;
+		checkpoints = NULL;
+		nextCheckpointTick = 0;
+	}
+	void MidiReader::Track::readEvents(){
+		do {
+			auto e = handleNextEvent();
+			if(e == NUM_EVENTS){
+				// An unknown event was seen.
+				break;
+			}
+			// Record a checkpoint once enough ticks have passed since the last one.
+			if(checkpoints && runningTime >= nextCheckpointTick){
+				checkpoints->checkpoints.push_back({file->input.tellg(), lastSeenEventType, runningTime, lastSeenTempo, ns.getNotesThatAreOn()});
+				nextCheckpointTick = runningTime - runningTime % file->checkpointInterval + file->checkpointInterval;
+			}
+		} while(!sawTrackEnd);
+		// Check whether the end of the track was seen.
+		trackValid = sawTrackEnd;
+		// Move to the end of the chunk in case the track ended early or had extra data after its end.
+		if(file->input){
+			file->input.seekg(streamPositionStart + (streamoff)lengthMTrk);
+		}
+	}
 	MidiReader::Track::Event MidiReader::Track::handleNextEvent(){
 		if(endOfData()){
 			return NUM_EVENTS;
@@ -213,12 +399,14 @@ namespace MusicCodes {
 						break;
 					case 0x03: {
 						// Sequence/Track Name
-						// Read next metaLength bytes as a string.
-						char buffer[metaLength + 1];
-						file->input.read(buffer, metaLength);
-						buffer[metaLength] = 0;
-						// Invoke string& operator= (const char* s).
-						name = buffer;
+						// Read next metaLength bytes as a string, but never more than what is left of the chunk,
+						// because the length comes straight from the file.
+						streamoff bytesLeft = max<streamoff>(streamPositionStart + (streamoff)lengthMTrk - file->input.tellg(), 0);
+						string buffer(min<streamoff>(metaLength, bytesLeft), '\0');
+						file->input.read(&buffer[0], buffer.size());
+						// Stop the name at the first null character like a C string.
+						name = buffer.c_str();
+						file->skipBytes(metaLength - buffer.size());
 						break;
 					}
 					case 0x2F:
@@ -236,6 +424,7 @@ namespace MusicCodes {
 							*((char*)&lastSeenTempo + 2) = file->input.get();
 							*((char*)&lastSeenTempo + 1) = file->input.get();
 							*((char*)&lastSeenTempo + 0) = file->input.get();
+							file->addTempoChange(runningTime, lastSeenTempo);
 						}else{
 							// The length is incorrect.
 							file->skipBytes(metaLength);
@@ -250,6 +439,7 @@ namespace MusicCodes {
 							delete lastSeenTimeSignature;
 							// Save the new time signature. The constructor reads four bytes.
 							lastSeenTimeSignature = new TimeSignature(file->input);
+							file->addTimeSignature(runningTime, *lastSeenTimeSignature);
 						}else{
 							// The length is incorrect.
 							file->skipBytes(metaLength);
@@ -279,8 +469,8 @@ namespace MusicCodes {
 			case 0xF7:
 			case 0xF0:
 				// We're not doing anything with system exclusive events for now.
-				// Scan until the End-of-Exclusive event.
-				while(file->input.get() != 0xF7);
+				// Skip over the data, whose length comes right after the event type.
+				file->skipBytes(file->getVariableLengthValue());
 				return SYSEX_EVENT;
 			default:
 				// For some events, the lower 4 bits represent the channel number.
@@ -311,9 +501,12 @@ namespace MusicCodes {
 						ns.handleNoteOn(eventType & 0x0F, runningTime, pitch);
 						return NOTE_ON_EVENT;
 					}
-					//case 0xA0:
+					case 0xA0:
 						// Poly Key Pressure
 					case 0xB0:
+						// Control Change
+					case 0xE0:
+						// Pitch Bend
 						// This is a channel event.
 						// Just skip over the next two bytes.
 						file->skipBytes(2);
@@ -323,10 +516,10 @@ namespace MusicCodes {
 						// Skip one byte.
 						file->skipBytes(1);
 						return PROGRAM_CHANGE;
-					//case 0xD0:
+					case 0xD0:
 						// Channel Pressure
-					//case 0xF0:
-						// Pitch Bend
+						file->skipBytes(1);
+						return CHANNEL_EVENT;
 				}
 		}
 		// Return NUM_EVENTS to indicate that the event type was unknown.
@@ -345,6 +538,20 @@ namespace MusicCodes {
 		clocksPerMetronomeTick = is.get();
 		demisemiquaversPerQuarterNote = is.get();
 	}
+	MidiReader::Track::TimeSignature::TimeSignature(uint8_t numerator, uint8_t denominatorLog2, uint8_t clocksPerMetronomeTick, uint8_t demisemiquaversPerQuarterNote)
+	: numerator(numerator), denominatorLog2(denominatorLog2), clocksPerMetronomeTick(clocksPerMetronomeTick), demisemiquaversPerQuarterNote(demisemiquaversPerQuarterNote) {}
+	uint8_t MidiReader::Track::TimeSignature::getNumerator() const {
+		return numerator;
+	}
+	uint8_t MidiReader::Track::TimeSignature::getDenominatorLog2() const {
+		return denominatorLog2;
+	}
+	uint8_t MidiReader::Track::TimeSignature::getClocksPerMetronomeTick() const {
+		return clocksPerMetronomeTick;
+	}
+	uint8_t MidiReader::Track::TimeSignature::getDemisemiquaversPerQuarterNote() const {
+		return demisemiquaversPerQuarterNote;
+	}
 	// MidiReader::Track::KeySignature
 	MidiReader::Track::KeySignature::KeySignature(istream& is){
 		numSharpsFlats = is.get();
@@ -365,38 +572,17 @@ namespace MusicCodes {
 		auto on = notesThatAreOn[midiChannel].find(p);
 		if(on != notesThatAreOn[midiChannel].end()){
 			// The note is currently turned on.
-			// Get ratio of this note length to a quarter note. For example, an eighth note gets a ratio
-			// of 0.5 because it is half of a quarter note. Round to the nearest multiple of the shortest note.
-			// Also increase the note duration by 5% because humans and software insert a small gap between notes.
-			double fractionOfQuarterNote = round(
-				(double)(ticksSinceBeginningOfTrack - on->second) /            // Number of ticks since beginning of note
-				parent->file->getTicksPerQuarterNote(parent->lastSeenTempo) /  // Number of ticks per quarter note
-				SHORTEST_NOTE *
-				1.05                                                           // Adjust note duration by 5% to fill gap between notes
-			) * SHORTEST_NOTE;
-			// Before running this through the logarithm function, we have to make sure that it isn't zero or negative.
-			if(fractionOfQuarterNote > 0){
-				// Figure out how many dots the note should have. Recall that a dot in music increases the note length by 50%.
-				int dots = 0;
-				double wholePart;
-				while(true){
-					// Find the logarithm base 2 of fractionOfQuarterNote and split it into its integer and fraction parts.
-					double fractionPart = modf(log2(fractionOfQuarterNote), &wholePart);
-					// If the result was close enough to a whole number, accept it.
-					if(abs(fractionPart) < 0.1){
-						break;
-					}
-					// Musically remove a dot.
-					fractionOfQuarterNote /= 1.5;
-					++dots;
-				}
-				// Subtract two from the log to convert from quarter=1 to whole=1.
-				wholePart -= 2.0;
+			// Round the length of the note to a duration with dots.
+			int duration, dots;
+			time_delta_t startTick = on->second;
+			// After seekToTick(), leave out the notes that stopped before the tick.
+			bool stoppedBeforeSeek = parent->file->seeking && ticksSinceBeginningOfTrack <= parent->file->seekTick;
+			if(!stoppedBeforeSeek && Note::quantize(ticksSinceBeginningOfTrack - startTick, parent->file->getTicksPerQuarterNote(parent->lastSeenTempo), duration, dots)){
 				// Add this to the priority_queue of notes.
 				// If another note that started after this one but finished before this one is already in the priority_queue,
 				// this note will move up ahead of it (because that's how a priority_queue works).
 				// The emplace() method requires C++ 2011.
-				pastNotes.emplace(midiChannel, ticksSinceBeginningOfTrack, Note(p, wholePart, dots, 0.000001 * on->second / parent->file->midiDivision * parent->lastSeenTempo));
+				pastNotes.emplace(startTick, PackedNote(p, duration, dots, midiChannel, 0), ticksSinceBeginningOfTrack);
 			}
 			// Erase the note from the map of notes that are on.
 			notesThatAreOn[midiChannel].erase(on);
@@ -406,17 +592,34 @@ namespace MusicCodes {
 		if(pastNotes.size()){
 			auto result = pastNotes.top();
 			pastNotes.pop();
-			return result.theNote;
+			// The times in microseconds are worked out here because the packed note does not have room for them.
+			const PackedNote& n = result.theNote;
+			return Note(
+				n.getPitch(), n.getDuration(), n.getDots(),
+				result.startTime, result.endTime,
+				parent->file->ticksToMicroseconds(result.startTime), parent->file->ticksToMicroseconds(result.endTime)
+			);
 		}
 		return Note::InvalidNote();
 	}
 	size_t MidiReader::Track::NoteSequence::numNotesRemaining() const {
 		return pastNotes.size();
 	}
-	MidiReader::Track::NoteSequence::NoteSequenceNote::NoteSequenceNote(channel_t channel, time_delta_t startTime, Note&& theNote)
-	: channel(channel), startTime(startTime), theNote(move(theNote)) {}
+	const MidiReader::Track::ActiveNotes& MidiReader::Track::NoteSequence::getNotesThatAreOn() const {
+		return notesThatAreOn;
+	}
+	void MidiReader::Track::NoteSequence::setNotesThatAreOn(const ActiveNotes& notes){
+		notesThatAreOn = notes;
+	}
+	MidiReader::Track::NoteSequence::NoteSequenceNote::NoteSequenceNote(time_delta_t startTime, const PackedNote& theNote, time_delta_t endTime)
+	: startTime(startTime), theNote(theNote), endTime(endTime) {}
 	bool MidiReader::Track::NoteSequence::NoteSequenceNoteCompare::operator()(const NoteSequenceNote& lhs, const NoteSequenceNote& rhs){
 		// We want the priority_queue to bring notes with earlier start times to the top of the heap.
-		return lhs.startTime > rhs.startTime;
+		// Notes that start together come out from lowest to highest so that chords are always in the same order.
+		// The packed notes all start at tick 0, so they compare by pitch and then channel.
+		if(lhs.startTime != rhs.startTime){
+			return lhs.startTime > rhs.startTime;
+		}
+		return lhs.theNote > rhs.theNote;
 	}
 }
@@ -20,7 +20,9 @@
 #include <map>
 #include <queue>
 #include <string>
+#include <vector>
 #include "Note.h"
+#include "PackedNote.h"
 namespace MusicCodes {
 	class MidiReader {
 		friend std::ostream& operator<<(std::ostream&, const MidiReader&);
@@ -29,13 +31,39 @@ namespace MusicCodes {
 		// TODO: copy and move constructors
 		~MidiReader();
 		Note getNextNote();
-		unsigned int getTicksPerQuarterNote(uint32_t microsecondsPerQuarterNote);
+		unsigned int getTicksPerQuarterNote(uint32_t microsecondsPerQuarterNote) const;
+		// Returns the number of ticks per quarter note at a tick, using the tempo changes that have been read so far.
+		// This only depends on the tempo in files with SMPTE divisions.
+		unsigned int getTicksPerQuarterNoteAt(int64_t tick) const;
+		// Converts a number of ticks since the beginning of the track into microseconds, using the
+		// tempo changes that have been read so far. The result is exact except for the rounding down
+		// of a single division for each tempo.
+		int64_t ticksToMicroseconds(int64_t tick) const;
+		// Converts many ticks at once. This is fastest when the ticks are sorted because then the
+		// tempo change that applies only has to be looked up when it changes.
+		void ticksToMicroseconds(const int64_t* ticks, int64_t* microseconds, std::size_t count) const;
 		operator bool() const;
 		std::streampos tellg();
+		// Reads through the whole file once, recording a checkpoint in every track every intervalTicks ticks,
+		// and then goes back to the first track. Returns false for multi-song files and invalid files.
+		bool buildCheckpoints(unsigned int intervalTicks);
+		// Makes getNextNote() start over from the tick in every track by resuming from the last checkpoint
+		// before it. Only the notes that are still sounding at the tick or that start after it are returned.
+		// Returns false if buildCheckpoints() has not succeeded.
+		bool seekToTick(int64_t tick);
 		enum FORMAT { SINGLE_TRACK, MULTI_TRACK, MULTI_SONG, NUM_FORMATS };
+		FORMAT getFormat() const;
+		uint16_t getNumTracks() const;
+		// The timing division as stored in the header. A negative value means SMPTE timing.
+		int16_t getDivision() const;
+	private:
+		struct TrackCheckpoints;
+	public:
 		class Track {
 		public:
 			Track(MidiReader*);
+			// Resumes reading a track from the last checkpoint at or before the tick that was passed to seekToTick().
+			Track(MidiReader*, const TrackCheckpoints&);
 			~Track();
 			// TODO: copy and move constructors
 			operator bool() const;
@@ -57,6 +85,11 @@ namespace MusicCodes {
 				// Construct a new time signature. Pass in a reference to the MIDI file.
 				// The next four bytes will be read and interpreted as the time signature.
 				TimeSignature(std::istream&);
+				TimeSignature(uint8_t numerator, uint8_t denominatorLog2, uint8_t clocksPerMetronomeTick = 24, uint8_t demisemiquaversPerQuarterNote = 8);
+				uint8_t getNumerator() const;
+				uint8_t getDenominatorLog2() const;
+				uint8_t getClocksPerMetronomeTick() const;
+				uint8_t getDemisemiquaversPerQuarterNote() const;
 			private:
 				// The time signature's numerator. Example: the numerator of 6/8 is 6.
 				uint8_t numerator;
@@ -81,8 +114,10 @@ namespace MusicCodes {
 				bool minor;
 			};
 			using pitch_t = uint8_t;
-			using time_delta_t = unsigned int;
+			using time_delta_t = int64_t;
 			using channel_t = uint8_t;
+			// The start times of the notes that are on, by channel and then by pitch
+			using ActiveNotes = std::map<channel_t, std::map<pitch_t, time_delta_t>>;
 		private:
 			bool trackValid;
 			bool sawTrackEnd;
@@ -106,7 +141,15 @@ namespace MusicCodes {
 			// The last event code that was seen (useful for running status encoding)
 			unsigned char lastSeenEventType;
 			// Total number of MIDI deltas since the beginning of the track
-			unsigned int runningTime;
+			time_delta_t runningTime;
+			// Where checkpoints are being recorded for this track (NULL if they are not being recorded)
+			TrackCheckpoints* checkpoints;
+			// The tick at or after which the next checkpoint will be recorded
+			time_delta_t nextCheckpointTick;
+			// Sets every field to the state at the beginning of a track.
+			void initialize();
+			// Reads events until the end of the track and then moves to the end of the chunk.
+			void readEvents();
 			// This class keeps track of notes as we read the entire track.
 			class NoteSequence {
 			public:
@@ -115,20 +158,24 @@ namespace MusicCodes {
 				void handleNoteOff(channel_t midiChannel, time_delta_t ticksSinceBeginningOfTrack, pitch_t p);
 				Note getNextNote();
 				std::size_t numNotesRemaining() const;
+				const ActiveNotes& getNotesThatAreOn() const;
+				void setNotesThatAreOn(const ActiveNotes&);
+				// The priority_queue holds packed notes so that moving notes around the heap is cheap.
+				// The start and end ticks are kept beside the packed note because tracks can run past
+				// the 40 bits that PackedNote has for the start tick.
 				struct NoteSequenceNote {
-					NoteSequenceNote(channel_t, time_delta_t, Note&&);
-					// The MIDI channel
-					channel_t channel;
-					// The number of MIDI deltas since the beginning of the track
+					NoteSequenceNote(time_delta_t, const PackedNote&, time_delta_t);
+					// The number of MIDI deltas since the beginning of the track that the note was started
 					time_delta_t startTime;
-					// The actual note
-					Note theNote;
+					// The pitch, duration, and channel. Its start tick is always 0.
+					PackedNote theNote;
+					// The number of MIDI deltas since the beginning of the track that the note was stopped
+					time_delta_t endTime;
 				};
-				static constexpr double SHORTEST_NOTE = 0.125; // 32nd note is 1/8 of a quarter note
 			private:
 				Track* parent;
 				// Keep track of notes that have not yet been turned off.
-				std::map<channel_t, std::map<pitch_t, time_delta_t>> notesThatAreOn;
+				ActiveNotes notesThatAreOn;
 				struct NoteSequenceNoteCompare {
 					bool operator()(const NoteSequenceNote& lhs, const NoteSequenceNote& rhs);
 				};
@@ -137,6 +184,14 @@ namespace MusicCodes {
 			};
 			NoteSequence ns;
 		};
+		// A time signature, along with the tick at which it starts
+		struct TimeSignatureChange {
+			int64_t tick;
+			Track::TimeSignature timeSignature;
+		};
+		// Returns every time signature that has been read so far, sorted by tick.
+		// In multi-track files, the time signatures of every track apply to every other track.
+		const std::vector<TimeSignatureChange>& getTimeSignatures() const;
 	private:
 		std::istream& input;
 		// Whether the input istream contained a valid MIDI header
@@ -151,6 +206,52 @@ namespace MusicCodes {
 		int16_t midiDivision;
 		// The MIDI track that is currently being read (NULL if no track is being read)
 		Track* currentTrack;
+		// A tempo change, along with the time in microseconds at which it happens
+		struct TempoChange {
+			int64_t tick;
+			uint32_t microsecondsPerQuarterNote;
+			int64_t microseconds;
+		};
+		// Every tempo change that has been read so far, sorted by tick. The first one is always at tick 0.
+		// In multi-track files, the tempo changes of every track apply to every other track.
+		std::vector<TempoChange> tempoMap;
+		// Adds a tempo change to tempoMap, replacing any other tempo change at the same tick.
+		void addTempoChange(int64_t tick, uint32_t microsecondsPerQuarterNote);
+		// Removes all tempo changes and goes back to the default tempo.
+		void resetTempoMap();
+		// Every time signature that has been read so far, sorted by tick
+		std::vector<TimeSignatureChange> timeSignatures;
+		// Adds a time signature to timeSignatures, replacing any other time signature at the same tick.
+		void addTimeSignature(int64_t tick, const Track::TimeSignature& timeSignature);
+		// The state of a track right after an event, so that reading can resume from there
+		struct Checkpoint {
+			// The position of the istream right after the event
+			std::streampos position;
+			unsigned char lastSeenEventType;
+			Track::time_delta_t runningTime;
+			uint32_t lastSeenTempo;
+			Track::ActiveNotes notesThatAreOn;
+		};
+		// The checkpoints of one track, sorted by runningTime
+		struct TrackCheckpoints {
+			std::streampos streamPositionStart;
+			uint32_t lengthMTrk;
+			std::vector<Checkpoint> checkpoints;
+		};
+		// The checkpoints of every track that was found by buildCheckpoints()
+		std::vector<TrackCheckpoints> checkpointTable;
+		// How often to record checkpoints, in ticks, while buildCheckpoints() is reading (0 otherwise)
+		unsigned int checkpointInterval;
+		// Whether getNextNote() is going through the tracks in checkpointTable because of seekToTick()
+		bool seeking;
+		// The tick that was passed to seekToTick()
+		int64_t seekTick;
+		// The index in checkpointTable of the next track to resume
+		std::size_t nextSeekTrack;
+		// Returns the last tempo change at or before the tick.
+		const TempoChange& getTempoAt(int64_t tick) const;
+		// Converts ticks into microseconds using a single tempo change.
+		int64_t ticksToMicroseconds(int64_t tick, const TempoChange& tempo) const;
 		// Reads the next sizeof(T) bytes from the istream and returns them as type T
 		template <class T> T getValue();
 		// Reads a variable-length value from the istream and returns it
@@ -0,0 +1,371 @@
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MidiRewriter.h"
+using namespace std;
+namespace {
+	// A single event in the data of a track, as found by nextEvent()
+	struct RawEvent {
+		// The time since the last event, in ticks
+		uint32_t delta;
+		// The status byte that applies to this event, even if it was omitted because of running status
+		uint8_t status;
+		// Whether the status byte was actually stored in the data
+		bool hasStatusByte;
+		// The position of the status byte, or where it would have been
+		const uint8_t* statusPosition;
+		// The position of the first byte after the status byte
+		const uint8_t* data;
+		// The position right after the last byte of the event
+		const uint8_t* end;
+	};
+	// Reads a variable-length value and moves p past it. Returns false if the value runs past end.
+	bool readVariableLengthValue(const uint8_t*& p, const uint8_t* end, uint32_t& result){
+		result = 0;
+		// MIDI never uses more than four bytes for a variable-length value.
+		for(int i = 0; i < 4 && p < end; ++i){
+			uint8_t nextByte = *p++;
+			result = (result << 7) | (nextByte & 0x7F);
+			if(!(nextByte & 0x80)){
+				return true;
+			}
+		}
+		return false;
+	}
+	void writeVariableLengthValue(vector<uint8_t>& out, uint32_t value){
+		// Collect groups of seven bits from least to most significant, then write them in reverse.
+		uint8_t buffer[5];
+		int length = 0;
+		do {
+			buffer[length++] = value & 0x7F;
+			value >>= 7;
+		} while(value);
+		while(length > 1){
+			out.push_back(buffer[--length] | 0x80);
+		}
+		out.push_back(buffer[0]);
+	}
+	uint32_t readUint32(const uint8_t* p){
+		return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	}
+	void writeUint32(uint8_t* p, uint32_t value){
+		p[0] = value >> 24;
+		p[1] = value >> 16;
+		p[2] = value >> 8;
+		p[3] = value;
+	}
+	// Returns the number of data bytes that follow the status byte of a channel event.
+	int channelEventLength(uint8_t status){
+		switch(status & 0xF0){
+			case 0xC0:
+				// Program Change
+			case 0xD0:
+				// Channel Pressure
+				return 1;
+			default:
+				return 2;
+		}
+	}
+	// Reads the next event starting at p and moves p past it.
+	// runningStatus holds the last channel status byte that was seen.
+	// Returns false if the event is malformed or runs past end.
+	bool nextEvent(const uint8_t*& p, const uint8_t* end, uint8_t& runningStatus, RawEvent& e){
+		if(!readVariableLengthValue(p, end, e.delta) || p >= end){
+			return false;
+		}
+		e.statusPosition = p;
+		if(*p < 0x80){
+			// Running status: reuse the last channel status byte.
+			if(!runningStatus){
+				return false;
+			}
+			e.status = runningStatus;
+			e.hasStatusByte = false;
+		}else{
+			e.status = *p++;
+			e.hasStatusByte = true;
+		}
+		e.data = p;
+		uint32_t length;
+		switch(e.status){
+			case 0xFF:
+				// Meta event: a type byte, a variable-length length, and then the data
+				if(p >= end){
+					return false;
+				}
+				++p;
+				// Fall through to read the length and data.
+			case 0xF0:
+			case 0xF7:
+				// System exclusive event: a variable-length length, and then the data
+				if(!readVariableLengthValue(p, end, length) || (uint32_t)(end - p) < length){
+					return false;
+				}
+				p += length;
+				break;
+			default:
+				if(e.status < 0x80 || e.status >= 0xF0){
+					// These are not allowed in a MIDI file.
+					return false;
+				}
+				if(end - p < channelEventLength(e.status)){
+					return false;
+				}
+				p += channelEventLength(e.status);
+				runningStatus = e.status;
+		}
+		e.end = p;
+		return true;
+	}
+	// Writes all of the bytes in the buffer to the file descriptor. Returns whether successful.
+	bool writeAll(int fd, const uint8_t* buffer, size_t length){
+		while(length){
+			ssize_t written = write(fd, buffer, length);
+			if(written < 0){
+				return false;
+			}
+			buffer += written;
+			length -= written;
+		}
+		return true;
+	}
+}
+namespace MusicCodes {
+	MidiRewriter::MidiRewriter() : transpose(0), velocityScale(1.0), tracksPatched(0), tracksReencoded(0), eventsPatched(0) {
+		for(int c = 0; c < 16; ++c){
+			channelMap[c] = c;
+		}
+	}
+	void MidiRewriter::setTranspose(int halfSteps){
+		transpose = halfSteps;
+	}
+	void MidiRewriter::setVelocityScale(double factor){
+		velocityScale = factor;
+	}
+	void MidiRewriter::mapChannel(uint8_t from, int to){
+		channelMap[from & 0x0F] = to < 0 ? -1 : to & 0x0F;
+	}
+	bool MidiRewriter::rewriteFile(const string& inputPath, const string& outputPath){
+		tracksPatched = 0;
+		tracksReencoded = 0;
+		eventsPatched = 0;
+		// Map the whole file copy-on-write. Patching a byte copies only the page that it is on,
+		// and the file on disk never changes.
+		int fd = open(inputPath.c_str(), O_RDONLY);
+		if(fd < 0){
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) != 0 || st.st_size < 14){
+			close(fd);
+			return false;
+		}
+		size_t size = st.st_size;
+		void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if(mapping == MAP_FAILED){
+			return false;
+		}
+		uint8_t* begin = static_cast<uint8_t*>(mapping);
+		uint8_t* end = begin + size;
+		// Tracks that had to be re-encoded, as the offset and length of the original chunk
+		// and the replacement chunk
+		vector<pair<size_t, size_t>> replacedChunks;
+		vector<vector<uint8_t>> replacements;
+		bool success = memcmp(begin, "MThd", 4) == 0;
+		if(success){
+			// Skip the header chunk. Its length field is usually 6, but the chunk is skipped by its length anyway.
+			uint8_t* p = begin + 8 + readUint32(begin + 4);
+			// Go through the rest of the chunks.
+			while(success && end - p >= 8){
+				uint32_t length = readUint32(p + 4);
+				if((size_t)(end - p - 8) < length){
+					success = false;
+					break;
+				}
+				uint8_t* data = p + 8;
+				if(memcmp(p, "MTrk", 4) == 0){
+					if(dropsChannels() && trackDropsEvents(data, data + length)){
+						// The track will get shorter, so it has to be re-encoded.
+						replacements.emplace_back();
+						success = reencodeTrack(data, data + length, replacements.back());
+						replacedChunks.emplace_back(p - begin, 8 + length);
+						++tracksReencoded;
+					}else{
+						success = patchTrack(data, data + length);
+						++tracksPatched;
+					}
+				}
+				// Alien chunks are copied as they are.
+				p = data + length;
+			}
+		}
+		if(success){
+			int out = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			success = out >= 0;
+			if(success){
+				// Write the mapping, substituting the re-encoded chunks.
+				size_t position = 0;
+				for(size_t i = 0; success && i < replacedChunks.size(); ++i){
+					success =
+						writeAll(out, begin + position, replacedChunks[i].first - position) &&
+						writeAll(out, replacements[i].data(), replacements[i].size());
+					position = replacedChunks[i].first + replacedChunks[i].second;
+				}
+				success = success && writeAll(out, begin + position, size - position);
+				success = close(out) == 0 && success;
+				if(!success){
+					unlink(outputPath.c_str());
+				}
+			}
+		}
+		munmap(mapping, size);
+		return success;
+	}
+	size_t MidiRewriter::getTracksPatched() const {
+		return tracksPatched;
+	}
+	size_t MidiRewriter::getTracksReencoded() const {
+		return tracksReencoded;
+	}
+	size_t MidiRewriter::getEventsPatched() const {
+		return eventsPatched;
+	}
+	uint8_t MidiRewriter::transposePitch(uint8_t pitch) const {
+		int result = pitch + transpose;
+		// Fold the pitch back into the MIDI range by whole octaves.
+		if(result < 0){
+			result += 12 * ((11 - result) / 12);
+		}else if(result > 127){
+			result -= 12 * ((result - 127 + 11) / 12);
+		}
+		return result;
+	}
+	uint8_t MidiRewriter::scaleVelocity(uint8_t velocity) const {
+		long result = lround(velocity * velocityScale);
+		return result < 1 ? 1 : result > 127 ? 127 : result;
+	}
+	bool MidiRewriter::dropsChannels() const {
+		for(int c = 0; c < 16; ++c){
+			if(channelMap[c] < 0){
+				return true;
+			}
+		}
+		return false;
+	}
+	bool MidiRewriter::patchTrack(uint8_t* begin, uint8_t* end){
+		// Look up the new pitches and velocities in tables instead of computing them for every event.
+		uint8_t pitches[128], velocities[128];
+		for(int i = 0; i < 128; ++i){
+			pitches[i] = transposePitch(i);
+			velocities[i] = i ? scaleVelocity(i) : 0;
+		}
+		const uint8_t* p = begin;
+		uint8_t runningStatus = 0;
+		RawEvent e;
+		while(p < end){
+			if(!nextEvent(p, end, runningStatus, e)){
+				return false;
+			}
+			if(e.status >= 0xF0){
+				// Meta and system exclusive events are left alone.
+				continue;
+			}
+			// The mapping is private to this process, so it is safe to write through these pointers.
+			uint8_t* data = const_cast<uint8_t*>(e.data);
+			uint8_t channel = e.status & 0x0F;
+			if(e.hasStatusByte){
+				// With running status, the status byte that was omitted has already been patched.
+				*const_cast<uint8_t*>(e.statusPosition) = (e.status & 0xF0) | channelMap[channel];
+			}
+			switch(e.status & 0xF0){
+				case 0x90:
+					// Note On
+					data[1] = velocities[data[1] & 0x7F];
+					// Fall through to transpose the pitch.
+				case 0x80:
+					// Note Off
+				case 0xA0:
+					// Poly Key Pressure
+					data[0] = pitches[data[0] & 0x7F];
+					break;
+			}
+			++eventsPatched;
+		}
+		return true;
+	}
+	bool MidiRewriter::reencodeTrack(const uint8_t* begin, const uint8_t* end, vector<uint8_t>& out){
+		out.reserve(end - begin + 8);
+		// Start with the chunk header. The length is filled in at the end.
+		out.insert(out.end(), {'M', 'T', 'r', 'k', 0, 0, 0, 0});
+		const uint8_t* p = begin;
+		uint8_t runningStatus = 0;
+		// The last status byte that was written, so that running status can be used in the output too
+		uint8_t lastWrittenStatus = 0;
+		// Time from events that were dropped, which gets added to the next event that is kept
+		uint32_t droppedTime = 0;
+		RawEvent e;
+		while(p < end){
+			if(!nextEvent(p, end, runningStatus, e)){
+				return false;
+			}
+			if(e.status >= 0xF0){
+				// Meta and system exclusive events are copied as they are, status byte included.
+				writeVariableLengthValue(out, droppedTime + e.delta);
+				droppedTime = 0;
+				out.insert(out.end(), e.statusPosition, e.end);
+				lastWrittenStatus = 0;
+				continue;
+			}
+			int channel = channelMap[e.status & 0x0F];
+			if(channel < 0){
+				droppedTime += e.delta;
+				continue;
+			}
+			writeVariableLengthValue(out, droppedTime + e.delta);
+			droppedTime = 0;
+			uint8_t status = (e.status & 0xF0) | channel;
+			if(status != lastWrittenStatus){
+				out.push_back(status);
+				lastWrittenStatus = status;
+			}
+			size_t firstDataByte = out.size();
+			out.insert(out.end(), e.data, e.end);
+			uint8_t* data = out.data() + firstDataByte;
+			switch(e.status & 0xF0){
+				case 0x90:
+					// Note On
+					if(data[1]){
+						data[1] = scaleVelocity(data[1]);
+					}
+					// Fall through to transpose the pitch.
+				case 0x80:
+					// Note Off
+				case 0xA0:
+					// Poly Key Pressure
+					data[0] = transposePitch(data[0]);
+					break;
+			}
+			++eventsPatched;
+		}
+		writeUint32(out.data() + 4, out.size() - 8);
+		return true;
+	}
+	bool MidiRewriter::trackDropsEvents(const uint8_t* begin, const uint8_t* end) const {
+		const uint8_t* p = begin;
+		uint8_t runningStatus = 0;
+		RawEvent e;
+		while(p < end){
+			if(!nextEvent(p, end, runningStatus, e)){
+				return true;
+			}
+			if(e.status < 0xF0 && channelMap[e.status & 0x0F] < 0){
+				return true;
+			}
+		}
+		return false;
+	}
+}
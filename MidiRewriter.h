@@ -0,0 +1,67 @@
+/*
+	This class rewrites the notes and channels of a MIDI file without fully
+	decoding and re-encoding it.
+
+	The input file is mapped into memory copy-on-write, so the only pages that
+	get copied are the ones that actually contain a patched byte. Transposing,
+	remapping channels, and scaling velocities never change the length of an
+	event, so those edits are made directly on the mapped bytes. A track is
+	re-encoded only when its length changes, which happens when a channel is
+	dropped entirely.
+
+	The events are walked the same way that MidiReader::Track::handleNextEvent()
+	walks them, except that the walk works on raw bytes instead of an istream.
+*/
+#ifndef INCLUDE_MUSIC_CODES_MIDIREWRITER
+#define INCLUDE_MUSIC_CODES_MIDIREWRITER 1
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+namespace MusicCodes {
+	class MidiRewriter {
+	public:
+		MidiRewriter();
+		// Transpose every note by this many half steps. Notes that would leave the
+		// MIDI range of 0 to 127 are folded back into it by whole octaves.
+		void setTranspose(int halfSteps);
+		// Multiply the velocity of every note-on event by this factor. The result is
+		// kept between 1 and 127 so that a note-on never turns into a note-off.
+		void setVelocityScale(double factor);
+		// Move every channel event on channel `from` to channel `to`. Both channels are
+		// numbered from 0 to 15. If `to` is negative, the events are dropped instead.
+		void mapChannel(uint8_t from, int to);
+		// Rewrites the MIDI file at inputPath and writes the result to outputPath.
+		// Returns whether successful. The output file is not created on failure.
+		bool rewriteFile(const std::string& inputPath, const std::string& outputPath);
+		// Statistics about the last call to rewriteFile()
+		std::size_t getTracksPatched() const;
+		std::size_t getTracksReencoded() const;
+		std::size_t getEventsPatched() const;
+	private:
+		int transpose;
+		double velocityScale;
+		// The channel that each channel is mapped to, or -1 if it is dropped
+		int channelMap[16];
+		std::size_t tracksPatched;
+		std::size_t tracksReencoded;
+		std::size_t eventsPatched;
+		// Returns the pitch after transposing and folding.
+		uint8_t transposePitch(uint8_t pitch) const;
+		// Returns the velocity after scaling.
+		uint8_t scaleVelocity(uint8_t velocity) const;
+		// Returns whether any channel is mapped to -1.
+		bool dropsChannels() const;
+		// Patches the events between begin and end in place.
+		// Returns false if the track data could not be walked.
+		bool patchTrack(uint8_t* begin, uint8_t* end);
+		// Writes a new copy of the events between begin and end into out, leaving out the
+		// events on dropped channels. Returns false if the track data could not be walked.
+		bool reencodeTrack(const uint8_t* begin, const uint8_t* end, std::vector<uint8_t>& out);
+		// Returns whether the events between begin and end contain any event on a dropped channel.
+		// If the track data could not be walked, true is returned so that the track gets re-encoded,
+		// which will then report the failure.
+		bool trackDropsEvents(const uint8_t* begin, const uint8_t* end) const;
+	};
+}
+#endif
@@ -1,7 +1,10 @@
 #include <cmath>
 #include "Note.h"
 namespace MusicCodes {
-	Note::Note(uint8_t pitch, int duration, int dots, double start) : pitch(pitch), duration(duration), dots(dots), start(start) {}
+	Note::Note(uint8_t pitch, int duration, int dots, double start)
+	: pitch(pitch), duration(duration), dots(dots), startTick(0), endTick(0), startMicroseconds(llround(start * 1000000)), endMicroseconds(startMicroseconds) {}
+	Note::Note(uint8_t pitch, int duration, int dots, int64_t startTick, int64_t endTick, int64_t startMicroseconds, int64_t endMicroseconds)
+	: pitch(pitch), duration(duration), dots(dots), startTick(startTick), endTick(endTick), startMicroseconds(startMicroseconds), endMicroseconds(endMicroseconds) {}
 	uint8_t Note::getPitch() const {
 		return pitch;
 	}
@@ -12,7 +15,22 @@ namespace MusicCodes {
 		return dots;
 	}
 	double Note::getStart() const {
-		return start;
+		return 0.000001 * startMicroseconds;
+	}
+	int64_t Note::getStartTick() const {
+		return startTick;
+	}
+	int64_t Note::getEndTick() const {
+		return endTick;
+	}
+	int64_t Note::getStartMicroseconds() const {
+		return startMicroseconds;
+	}
+	int64_t Note::getEndMicroseconds() const {
+		return endMicroseconds;
+	}
+	int64_t Note::getQuantizedEndTick(unsigned int ticksPerQuarterNote) const {
+		return startTick + getQuantizedTicks(duration, dots, ticksPerQuarterNote);
 	}
 	Note::operator bool() const {
 		return pitch <= 127 && dots >= 0;
@@ -20,6 +38,45 @@ namespace MusicCodes {
 	Note Note::InvalidNote(){
 		return {255, 0, -1};
 	}
+	bool Note::quantize(int64_t ticks, unsigned int ticksPerQuarterNote, int& duration, int& dots){
+		if(ticks <= 0 || !ticksPerQuarterNote){
+			return false;
+		}
+		// Get the number of shortest notes in this length of time, rounded to the nearest whole number.
+		// Also increase the note duration by 5% because humans and software insert a small gap between notes.
+		// In integers, that is round(ticks * 1.05 * SHORTEST_NOTES_PER_QUARTER_NOTE / ticksPerQuarterNote).
+		int64_t shortestNotes =
+			(ticks * 105 * SHORTEST_NOTES_PER_QUARTER_NOTE * 2 + (int64_t)ticksPerQuarterNote * 100) /
+			((int64_t)ticksPerQuarterNote * 200);
+		// Before running this through the logarithm function, we have to make sure that it isn't zero.
+		if(shortestNotes <= 0){
+			return false;
+		}
+		// Get ratio of this note length to a quarter note. For example, an eighth note gets a ratio
+		// of 0.5 because it is half of a quarter note.
+		double fractionOfQuarterNote = (double)shortestNotes / SHORTEST_NOTES_PER_QUARTER_NOTE;
+		// Figure out how many dots the note should have. Recall that a dot in music increases the note length by 50%.
+		dots = 0;
+		double wholePart;
+		while(true){
+			// Find the logarithm base 2 of fractionOfQuarterNote and split it into its integer and fraction parts.
+			double fractionPart = modf(log2(fractionOfQuarterNote), &wholePart);
+			// If the result was close enough to a whole number, accept it.
+			if(std::abs(fractionPart) < 0.1){
+				break;
+			}
+			// Musically remove a dot.
+			fractionOfQuarterNote /= 1.5;
+			++dots;
+		}
+		// Subtract two from the log to convert from quarter=1 to whole=1.
+		duration = wholePart - 2.0;
+		return true;
+	}
+	int64_t Note::getQuantizedTicks(int duration, int dots, unsigned int ticksPerQuarterNote){
+		// Add two to the exponent to convert from whole=1 to quarter=1, and add 50% for every dot.
+		return llround(ticksPerQuarterNote * exp2(duration + 2) * pow(1.5, dots));
+	}
 	const std::string Note::NOTE_NAMES[] = {
 		"C",
 		"C#",
@@ -11,16 +11,31 @@ namespace MusicCodes {
 		friend std::ostream& operator<<(std::ostream&, const Note&);
 	public:
 		Note(uint8_t pitch, int duration, int dots, double start = 0);
+		Note(uint8_t pitch, int duration, int dots, int64_t startTick, int64_t endTick, int64_t startMicroseconds, int64_t endMicroseconds);
 		uint8_t getPitch() const;
 		int getDuration() const;
 		int getDots() const;
+		// The number of seconds since the beginning of the MIDI track that this note was started
 		double getStart() const;
+		int64_t getStartTick() const;
+		int64_t getEndTick() const;
+		int64_t getStartMicroseconds() const;
+		int64_t getEndMicroseconds() const;
+		// The tick that this note would end on if it lasted for exactly its duration and dots
+		int64_t getQuantizedEndTick(unsigned int ticksPerQuarterNote) const;
 		// Whether this is a valid note
 		operator bool() const;
 		// Returns an invalid note
 		static Note InvalidNote();
 		// An array of note names
 		static const std::string NOTE_NAMES[];
+		// Durations are rounded to a multiple of the shortest note. A 32nd note is 1/8 of a quarter note.
+		static constexpr int SHORTEST_NOTES_PER_QUARTER_NOTE = 8;
+		// Converts a length of time in ticks into a duration and a number of dots.
+		// Returns false if the length rounds down to nothing.
+		static bool quantize(int64_t ticks, unsigned int ticksPerQuarterNote, int& duration, int& dots);
+		// Converts a duration and a number of dots back into a length of time in ticks.
+		static int64_t getQuantizedTicks(int duration, int dots, unsigned int ticksPerQuarterNote);
 	private:
 		// The MIDI pitch number of this note
 		uint8_t pitch;
@@ -31,8 +46,13 @@ namespace MusicCodes {
 		// For example, for a double-dotted whole note, duration=0 and dots=2.
 		int duration;
 		int dots;
-		// The number of seconds since the beginning of the MIDI track that this note was started.
-		double start;
+		// The number of MIDI ticks since the beginning of the MIDI track that this note was started and stopped.
+		int64_t startTick;
+		int64_t endTick;
+		// The number of microseconds since the beginning of the MIDI track that this note was started and stopped.
+		// These are exact conversions of startTick and endTick using the tempo changes in the file.
+		int64_t startMicroseconds;
+		int64_t endMicroseconds;
 	};
 }
 #endif
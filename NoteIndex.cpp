@@ -0,0 +1,75 @@
+#include <algorithm>
+#include "NoteIndex.h"
+using namespace std;
+namespace MusicCodes {
+	NoteIndex::NoteIndex(vector<Note> notes) : notes(move(notes)), maxEndTick(this->notes.size()), maxEndMicroseconds(this->notes.size()) {
+		stable_sort(this->notes.begin(), this->notes.end(), [](const Note& lhs, const Note& rhs){
+			return lhs.getStartTick() < rhs.getStartTick();
+		});
+		build(0, this->notes.size());
+	}
+	vector<Note> NoteIndex::getNotesBetweenTicks(int64_t startTick, int64_t endTick) const {
+		vector<Note> result;
+		find(0, notes.size(), startTick, endTick, false, result);
+		return result;
+	}
+	vector<Note> NoteIndex::getNotesAtTick(int64_t tick) const {
+		return getNotesBetweenTicks(tick, tick + 1);
+	}
+	vector<Note> NoteIndex::getNotesBetweenMicroseconds(int64_t startMicroseconds, int64_t endMicroseconds) const {
+		vector<Note> result;
+		find(0, notes.size(), startMicroseconds, endMicroseconds, true, result);
+		return result;
+	}
+	vector<Note> NoteIndex::getNotesAtMicrosecond(int64_t microseconds) const {
+		return getNotesBetweenMicroseconds(microseconds, microseconds + 1);
+	}
+	vector<Note> NoteIndex::getNotesInBars(const BarGrid& grid, int64_t firstBar, int64_t lastBar) const {
+		return getNotesBetweenTicks(grid.getBarStart(firstBar), grid.getBarStart(lastBar + 1));
+	}
+	size_t NoteIndex::size() const {
+		return notes.size();
+	}
+	void NoteIndex::build(size_t lo, size_t hi){
+		if(lo >= hi){
+			return;
+		}
+		size_t mid = lo + (hi - lo) / 2;
+		build(lo, mid);
+		build(mid + 1, hi);
+		// The latest end in this range is the latest of the root and the roots of both halves.
+		maxEndTick[mid] = notes[mid].getEndTick();
+		maxEndMicroseconds[mid] = notes[mid].getEndMicroseconds();
+		if(lo < mid){
+			size_t left = lo + (mid - lo) / 2;
+			maxEndTick[mid] = max(maxEndTick[mid], maxEndTick[left]);
+			maxEndMicroseconds[mid] = max(maxEndMicroseconds[mid], maxEndMicroseconds[left]);
+		}
+		if(mid + 1 < hi){
+			size_t right = mid + 1 + (hi - mid - 1) / 2;
+			maxEndTick[mid] = max(maxEndTick[mid], maxEndTick[right]);
+			maxEndMicroseconds[mid] = max(maxEndMicroseconds[mid], maxEndMicroseconds[right]);
+		}
+	}
+	void NoteIndex::find(size_t lo, size_t hi, int64_t start, int64_t end, bool microseconds, vector<Note>& result) const {
+		if(lo >= hi){
+			return;
+		}
+		size_t mid = lo + (hi - lo) / 2;
+		// If every note in this range ends before the start, none of them can overlap.
+		if((microseconds ? maxEndMicroseconds[mid] : maxEndTick[mid]) <= start){
+			return;
+		}
+		// Visit the earlier half first so that the result stays sorted.
+		find(lo, mid, start, end, microseconds, result);
+		const Note& n = notes[mid];
+		// If the root starts at or after the end, so does everything in the later half.
+		if((microseconds ? n.getStartMicroseconds() : n.getStartTick()) >= end){
+			return;
+		}
+		if((microseconds ? n.getEndMicroseconds() : n.getEndTick()) > start){
+			result.push_back(n);
+		}
+		find(mid + 1, hi, start, end, microseconds, result);
+	}
+}
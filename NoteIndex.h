@@ -0,0 +1,51 @@
+/*
+	This class shall find the notes that are sounding during a stretch of time
+	without going through every note.
+
+	The notes are sorted by start time and treated as an implicit balanced
+	binary search tree: the middle note of a range is the root of that range.
+	Every root remembers the latest end time in its range, so whole ranges of
+	notes that end too early are skipped. Queries take O(log n) time plus time
+	for the notes that are found.
+
+	Because the notes of a file are converted from ticks to microseconds with a
+	tempo map that only moves forward, the order by start tick is also the order
+	by start microsecond, so the same tree answers queries in either unit.
+*/
+#ifndef INCLUDE_MUSIC_CODES_NOTEINDEX
+#define INCLUDE_MUSIC_CODES_NOTEINDEX 1
+#include <cstdint>
+#include <vector>
+#include "BarGrid.h"
+#include "Note.h"
+namespace MusicCodes {
+	class NoteIndex {
+	public:
+		NoteIndex(std::vector<Note> notes);
+		// Returns the notes that are sounding at any time from the start tick up to but not
+		// including the end tick, sorted by start time.
+		std::vector<Note> getNotesBetweenTicks(int64_t startTick, int64_t endTick) const;
+		// Returns the notes that are sounding at the tick.
+		std::vector<Note> getNotesAtTick(int64_t tick) const;
+		// Returns the notes that are sounding at any time from the start time up to but not
+		// including the end time, sorted by start time.
+		std::vector<Note> getNotesBetweenMicroseconds(int64_t startMicroseconds, int64_t endMicroseconds) const;
+		// Returns the notes that are sounding at the time.
+		std::vector<Note> getNotesAtMicrosecond(int64_t microseconds) const;
+		// Returns the notes that are sounding at any time from the beginning of the first bar
+		// to the end of the last bar.
+		std::vector<Note> getNotesInBars(const BarGrid& grid, int64_t firstBar, int64_t lastBar) const;
+		std::size_t size() const;
+	private:
+		// The notes, sorted by start tick
+		std::vector<Note> notes;
+		// For the range of notes whose root is note i, the latest end tick and end time
+		std::vector<int64_t> maxEndTick;
+		std::vector<int64_t> maxEndMicroseconds;
+		// Fills in maxEndTick and maxEndMicroseconds for the range of notes from lo up to hi.
+		void build(std::size_t lo, std::size_t hi);
+		// Adds the notes in the range from lo up to hi that overlap the time from start up to end.
+		void find(std::size_t lo, std::size_t hi, int64_t start, int64_t end, bool microseconds, std::vector<Note>& result) const;
+	};
+}
+#endif
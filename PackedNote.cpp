@@ -0,0 +1,42 @@
+#include "PackedNote.h"
+namespace {
+	// Keeps a value between the lowest and highest values.
+	int64_t clamp(int64_t value, int64_t lowest, int64_t highest){
+		return value < lowest ? lowest : value > highest ? highest : value;
+	}
+}
+namespace MusicCodes {
+	PackedNote::PackedNote(uint8_t pitch, int duration, int dots, uint8_t channel, int64_t startTick) :
+		bits(
+			(uint64_t)clamp(startTick, 0, MAX_START_TICK) << START_TICK_SHIFT |
+			(uint64_t)(pitch & 0x7F) << PITCH_SHIFT |
+			(uint64_t)(channel & 0x0F) << CHANNEL_SHIFT |
+			(uint64_t)clamp(duration + DURATION_BIAS, 0, 0xFF) << DURATION_SHIFT |
+			(uint64_t)clamp(dots, 0, 0x1F) << DOTS_SHIFT
+		) {}
+	PackedNote::PackedNote(const Note& n, uint8_t channel) : PackedNote(n.getPitch(), n.getDuration(), n.getDots(), channel, n.getStartTick()) {}
+	uint8_t PackedNote::getPitch() const {
+		return bits >> PITCH_SHIFT & 0x7F;
+	}
+	int PackedNote::getDuration() const {
+		return (int)(bits >> DURATION_SHIFT & 0xFF) - DURATION_BIAS;
+	}
+	int PackedNote::getDots() const {
+		return bits >> DOTS_SHIFT & 0x1F;
+	}
+	uint8_t PackedNote::getChannel() const {
+		return bits >> CHANNEL_SHIFT & 0x0F;
+	}
+	int64_t PackedNote::getStartTick() const {
+		return bits >> START_TICK_SHIFT;
+	}
+	bool PackedNote::operator<(const PackedNote& rhs) const {
+		return bits < rhs.bits;
+	}
+	bool PackedNote::operator>(const PackedNote& rhs) const {
+		return bits > rhs.bits;
+	}
+	bool PackedNote::operator==(const PackedNote& rhs) const {
+		return bits == rhs.bits;
+	}
+}
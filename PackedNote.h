@@ -0,0 +1,50 @@
+/*
+	This class shall hold a note in eight bytes, for programs that keep a lot
+	of notes around.
+
+	The bits are laid out from most to least significant as:
+	  40 bits: the start tick
+	   7 bits: the MIDI pitch
+	   4 bits: the MIDI channel
+	   8 bits: the duration exponent, plus 128
+	   5 bits: the number of dots
+	Note::quantize() gives durations from -8 to 56 and up to 18 dots for any
+	length that fits in an int64_t, so every quantized note fits exactly.
+	Because the start tick comes first, comparing two packed notes as integers
+	orders them by start tick, then by pitch, and then by channel.
+
+	The end tick and the times in microseconds are not stored, so there is no
+	way back to a whole Note. Programs that need those should keep the Note.
+*/
+#ifndef INCLUDE_MUSIC_CODES_PACKEDNOTE
+#define INCLUDE_MUSIC_CODES_PACKEDNOTE 1
+#include <cstdint>
+#include "Note.h"
+namespace MusicCodes {
+	class PackedNote {
+	public:
+		// Values outside of the ranges of the fields are clamped.
+		PackedNote(uint8_t pitch, int duration, int dots, uint8_t channel, int64_t startTick);
+		PackedNote(const Note&, uint8_t channel = 0);
+		uint8_t getPitch() const;
+		int getDuration() const;
+		int getDots() const;
+		uint8_t getChannel() const;
+		int64_t getStartTick() const;
+		bool operator<(const PackedNote&) const;
+		bool operator>(const PackedNote&) const;
+		bool operator==(const PackedNote&) const;
+		static constexpr int64_t MAX_START_TICK = ((int64_t)1 << 40) - 1;
+	private:
+		uint64_t bits;
+		static constexpr int DOTS_SHIFT = 0;
+		static constexpr int DURATION_SHIFT = 5;
+		static constexpr int CHANNEL_SHIFT = 13;
+		static constexpr int PITCH_SHIFT = 17;
+		static constexpr int START_TICK_SHIFT = 24;
+		// The duration exponent is stored plus this, so that it is never negative.
+		static constexpr int DURATION_BIAS = 128;
+	};
+	static_assert(sizeof(PackedNote) == 8, "PackedNote must fit in eight bytes");
+}
+#endif
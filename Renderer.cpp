@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include "Renderer.h"
+using namespace std;
+namespace {
+	// Four floats or ints, which fit in one SSE or NEON register
+	typedef float float4 __attribute__((vector_size(16)));
+	typedef int32_t int4 __attribute__((vector_size(16)));
+	const float4 LANES = {0, 1, 2, 3};
+	// The lengths of the parts of the envelope in seconds, and the level that a held note fades to
+	const double ATTACK_SECONDS = 0.005;
+	const double DECAY_SECONDS = 0.08;
+	const float SUSTAIN_LEVEL = 0.6f;
+	const double RELEASE_SECONDS = 0.12;
+	// The oscillators add up this many harmonics, each one quieter than the last like a sawtooth wave.
+	const int NUM_HARMONICS = 4;
+	const float HARMONIC_LEVELS[NUM_HARMONICS] = {1.0f, 1.0f / 2, 1.0f / 3, 1.0f / 4};
+	// The volume of a single note. Chords of up to about five notes will not clip.
+	const float NOTE_LEVEL = 0.1f;
+	// Returns the sine of 2*pi*x for each x between -0.5 and 0.5.
+	float4 sine(float4 x){
+		// Fold x into the range from -0.25 to 0.25, where the sine wave is the same but mirrored.
+		x = x > 0.25f ? 0.5f - x : x;
+		x = x < -0.25f ? -0.5f - x : x;
+		// Use the Taylor series up to x^9, which is accurate to a few millionths in this range.
+		float4 t = x * (float)(2 * M_PI);
+		float4 t2 = t * t;
+		return t * (1 + t2 * (-1.0f / 6 + t2 * (1.0f / 120 + t2 * (-1.0f / 5040 + t2 * (1.0f / 362880)))));
+	}
+	// Returns x minus the closest whole number, for each x that is not negative.
+	float4 wrap(float4 x){
+		return x - __builtin_convertvector(__builtin_convertvector(x + 0.5f, int4), float4);
+	}
+	// What the renderer needs to know to play a note
+	struct Voice {
+		// The sample that the note starts on and the number of samples until it is released
+		int64_t startSample;
+		float length;
+		// The fraction of a cycle that the fundamental moves forward by every sample
+		double increment;
+		// The number of harmonics that are below the Nyquist frequency
+		int numHarmonics;
+	};
+	// Returns the level of the envelope at the times since the note started, in samples.
+	float4 envelope(float4 t, float length, float attack, float decay, float release){
+		float4 attackLevel = t / attack;
+		float4 decayLevel = 1 - (1 - SUSTAIN_LEVEL) * (t - attack) / decay;
+		float4 level = decayLevel > SUSTAIN_LEVEL ? decayLevel : SUSTAIN_LEVEL;
+		level = attackLevel < level ? attackLevel : level;
+		level = level > 0 ? level : 0;
+		// After the note is released, fade out from wherever the envelope was.
+		float4 releaseLevel = 1 - (t - length) / release;
+		releaseLevel = releaseLevel < 1 ? releaseLevel : 1;
+		releaseLevel = releaseLevel > 0 ? releaseLevel : 0;
+		return level * releaseLevel;
+	}
+	// Returns the sample after the last one that any of the notes can be heard on.
+	size_t getEndSample(const vector<MusicCodes::Note>& notes, unsigned int sampleRate){
+		int64_t lastMicroseconds = 0;
+		for(const MusicCodes::Note& n : notes){
+			lastMicroseconds = max(lastMicroseconds, n.getEndMicroseconds());
+		}
+		return (lastMicroseconds * sampleRate + 999999) / 1000000 + (size_t)ceil(RELEASE_SECONDS * sampleRate) + 1;
+	}
+}
+namespace MusicCodes {
+	Renderer::Renderer(vector<Note> notes, unsigned int sampleRate) :
+		sampleRate(sampleRate), numSamples(notes.empty() ? 0 : getEndSample(notes, sampleRate)), index(move(notes)) {}
+	vector<float> Renderer::render(unsigned int numThreads) const {
+		vector<float> samples(numSamples);
+		// Every thread takes the next second of sound that nobody has taken.
+		size_t numSeconds = (numSamples + sampleRate - 1) / sampleRate;
+		atomic<size_t> nextSecond(0);
+		vector<thread> threads;
+		for(unsigned int t = 0; t < max(numThreads, 1u); ++t){
+			threads.emplace_back([&]{
+				size_t i;
+				while((i = nextSecond++) < numSeconds){
+					size_t first = i * sampleRate;
+					renderRange(first, min(first + sampleRate, numSamples), samples.data());
+				}
+			});
+		}
+		for(thread& t : threads){
+			t.join();
+		}
+		// Turn the whole sound down if it would clip.
+		float peak = 0;
+		for(float sample : samples){
+			peak = max(peak, abs(sample));
+		}
+		if(peak > 1){
+			for(float& sample : samples){
+				sample /= peak;
+			}
+		}
+		return samples;
+	}
+	bool Renderer::writeWav(ostream& os, const vector<float>& samples) const {
+		// WAV files are little-endian.
+		auto write = [&](uint32_t value, int numBytes){
+			for(int i = 0; i < numBytes; ++i){
+				os.put(value >> (8 * i) & 0xFF);
+			}
+		};
+		uint32_t dataBytes = samples.size() * 2;
+		os << "RIFF";
+		write(36 + dataBytes, 4);
+		os << "WAVEfmt ";
+		// The format chunk: 16 bytes of uncompressed PCM with one channel of 16-bit samples
+		write(16, 4);
+		write(1, 2);
+		write(1, 2);
+		write(sampleRate, 4);
+		write(sampleRate * 2, 4);
+		write(2, 2);
+		write(16, 2);
+		os << "data";
+		write(dataBytes, 4);
+		for(float sample : samples){
+			write((uint16_t)(int16_t)lrint(sample * 32767), 2);
+		}
+		return (bool)os;
+	}
+	unsigned int Renderer::getSampleRate() const {
+		return sampleRate;
+	}
+	size_t Renderer::getNumSamples() const {
+		return numSamples;
+	}
+	void Renderer::renderRange(size_t first, size_t last, float* samples) const {
+		float attack = ATTACK_SECONDS * sampleRate;
+		float decay = DECAY_SECONDS * sampleRate;
+		float release = RELEASE_SECONDS * sampleRate;
+		// Find the notes that can be heard during this range, including the ones that are fading out.
+		vector<Voice> voices;
+		int64_t releaseMicroseconds = ceil(RELEASE_SECONDS * 1000000);
+		for(const Note& n : index.getNotesBetweenMicroseconds(samplesToMicroseconds(first) - releaseMicroseconds, samplesToMicroseconds(last) + 1)){
+			Voice v;
+			v.startSample = microsecondsToSamples(n.getStartMicroseconds());
+			v.length = microsecondsToSamples(n.getEndMicroseconds()) - v.startSample;
+			v.increment = 440 * exp2((n.getPitch() - 69) / 12.0) / sampleRate;
+			v.numHarmonics = min(NUM_HARMONICS, (int)(0.5 / v.increment));
+			voices.push_back(v);
+		}
+		// Mix the voices one block at a time.
+		float4 mix[BLOCK_SIZE / 4];
+		for(size_t block = first; block < last; block += BLOCK_SIZE){
+			size_t blockEnd = min(block + BLOCK_SIZE, last);
+			for(float4& m : mix){
+				m = float4{0, 0, 0, 0};
+			}
+			for(const Voice& v : voices){
+				// Only go through the groups of four samples where this note can be heard.
+				int64_t start = max<int64_t>(v.startSample, block);
+				int64_t end = min<int64_t>(v.startSample + (int64_t)v.length + (int64_t)release + 1, blockEnd);
+				for(int64_t group = (start - (int64_t)block) / 4; group * 4 < end - (int64_t)block; ++group){
+					int64_t sinceStart = (int64_t)block + group * 4 - v.startSample;
+					float4 t = (float)sinceStart + LANES;
+					// Work out the phase of the first sample in double precision so that long notes stay in tune.
+					double phase = sinceStart * v.increment;
+					float4 cycles = (float)(phase - floor(phase)) + LANES * (float)v.increment;
+					float4 sound = {0, 0, 0, 0};
+					for(int h = 0; h < v.numHarmonics; ++h){
+						sound += HARMONIC_LEVELS[h] * sine(wrap(cycles * (float)(h + 1)));
+					}
+					mix[group] += NOTE_LEVEL * envelope(t, v.length, attack, decay, release) * sound;
+				}
+			}
+			for(size_t i = block; i < blockEnd; ++i){
+				samples[i] = mix[(i - block) / 4][(i - block) % 4];
+			}
+		}
+	}
+	int64_t Renderer::microsecondsToSamples(int64_t microseconds) const {
+		return (microseconds * sampleRate + 500000) / 1000000;
+	}
+	int64_t Renderer::samplesToMicroseconds(int64_t samples) const {
+		return samples * 1000000 / sampleRate;
+	}
+}
@@ -0,0 +1,46 @@
+/*
+	This class shall turn notes into sound, so that the notes that were read
+	out of a MIDI file can be listened to.
+
+	Every note is played by an oscillator that adds up the first few harmonics
+	of its pitch and is shaped by an ADSR envelope. Four samples are worked out
+	at a time with GCC vector extensions. The sound is mixed in short blocks
+	that stay in the cache, and every second of sound is rendered by whichever
+	thread is free. Each sample only depends on the notes and its own position,
+	so the sound is the same no matter how many threads are used.
+*/
+#ifndef INCLUDE_MUSIC_CODES_RENDERER
+#define INCLUDE_MUSIC_CODES_RENDERER 1
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "Note.h"
+#include "NoteIndex.h"
+namespace MusicCodes {
+	class Renderer {
+	public:
+		// Pass in the notes to play. Every note plays from its start to its end in microseconds,
+		// and then fades out.
+		Renderer(std::vector<Note> notes, unsigned int sampleRate = 44100);
+		// Renders all of the notes into mono samples between -1 and 1.
+		std::vector<float> render(unsigned int numThreads) const;
+		// Writes samples as a 16-bit mono WAV file.
+		bool writeWav(std::ostream&, const std::vector<float>& samples) const;
+		unsigned int getSampleRate() const;
+		// The number of samples in the sound, up to the end of the last fade out
+		std::size_t getNumSamples() const;
+		// The number of samples that are mixed together at a time
+		static constexpr std::size_t BLOCK_SIZE = 256;
+	private:
+		unsigned int sampleRate;
+		// This is worked out from the notes before they are moved into the index, so it has to be declared first.
+		std::size_t numSamples;
+		NoteIndex index;
+		// Renders the samples from the first sample up to but not including the last sample.
+		void renderRange(std::size_t first, std::size_t last, float* samples) const;
+		int64_t microsecondsToSamples(int64_t microseconds) const;
+		int64_t samplesToMicroseconds(int64_t samples) const;
+	};
+}
+#endif
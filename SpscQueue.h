@@ -0,0 +1,68 @@
+/*
+	This class shall pass items from one thread to another through a bounded
+	ring buffer without locks.
+
+	Exactly one thread may push and exactly one thread may pop. The producer
+	only writes the tail and the consumer only writes the head, so each index
+	has a single writer and release/acquire ordering is all that is needed. A
+	push waits while the queue is full, which slows the producer down to the
+	speed of the consumer instead of letting the queue grow.
+*/
+#ifndef INCLUDE_MUSIC_CODES_SPSCQUEUE
+#define INCLUDE_MUSIC_CODES_SPSCQUEUE 1
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+namespace MusicCodes {
+	template <class T>
+	class SpscQueue {
+	public:
+		// The capacity is rounded up to a power of two.
+		explicit SpscQueue(std::size_t capacity) : head(0), tail(0) {
+			std::size_t size = 1;
+			while(size < capacity){
+				size <<= 1;
+			}
+			slots.resize(size);
+			mask = size - 1;
+		}
+		// Adds an item to the end of the queue, waiting while the queue is full.
+		void push(T&& item){
+			std::size_t t = tail.load(std::memory_order_relaxed);
+			// Wait for the consumer to make room.
+			for(int spins = 0; t - head.load(std::memory_order_acquire) > mask; ++spins){
+				wait(spins);
+			}
+			slots[t & mask] = std::move(item);
+			tail.store(t + 1, std::memory_order_release);
+		}
+		// Removes the item at the front of the queue, waiting while the queue is empty.
+		T pop(){
+			std::size_t h = head.load(std::memory_order_relaxed);
+			// Wait for the producer to add something.
+			for(int spins = 0; tail.load(std::memory_order_acquire) == h; ++spins){
+				wait(spins);
+			}
+			T item = std::move(slots[h & mask]);
+			head.store(h + 1, std::memory_order_release);
+			return item;
+		}
+	private:
+		std::vector<T> slots;
+		std::size_t mask;
+		// The head and tail are on separate cache lines so that the two threads do not keep
+		// taking the same cache line away from each other.
+		// The index of the next item to pop, which only the consumer writes
+		alignas(64) std::atomic<std::size_t> head;
+		// The index of the next item to push, which only the producer writes
+		alignas(64) std::atomic<std::size_t> tail;
+		// Spins for a little while before giving up the CPU to the other thread.
+		static void wait(int spins){
+			if(spins >= 64){
+				std::this_thread::yield();
+			}
+		}
+	};
+}
+#endif
@@ -0,0 +1,57 @@
+/*
+	Bar Notes
+
+	This program prints the notes that are sounding during some bars of a MIDI
+	file, along with the bar and beat that each note starts on.
+*/
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "BarGrid.h"
+#include "MidiReader.h"
+#include "Note.h"
+#include "NoteIndex.h"
+using namespace std;
+using namespace MusicCodes;
+int main(int argc, char** argv){
+	// This program expects a file path and bar numbers to be passed in as arguments.
+	if(argc < 3){
+		cout << "Bar Notes by David Tsai\n"
+			<< "This program prints the notes that are sounding during some bars of a MIDI\n"
+			<< "file. Bars are numbered from 1.\n"
+			<< "Pass in the path to a MIDI file, the first bar, and optionally the last bar." << endl;
+		return 0;
+	}
+	int64_t firstBar = atoll(argv[2]);
+	int64_t lastBar = argc > 3 ? atoll(argv[3]) : firstBar;
+	// Open the file.
+	ifstream midifile(argv[1]);
+	if(!midifile){
+		cerr << "This file could not be opened.\n";
+		return 1;
+	}
+	// Read the MIDI data.
+	MidiReader midiread(midifile);
+	if(!midiread){
+		cerr << "This is not a supported MIDI file.\n";
+		return 1;
+	}
+	// Read all of the notes so that the time signatures of every track are known.
+	vector<Note> notes;
+	Note n = Note::InvalidNote();
+	while((n = midiread.getNextNote())){
+		notes.push_back(n);
+	}
+	BarGrid grid(midiread.getTimeSignatures(), midiread.getTicksPerQuarterNote(500000));
+	NoteIndex index(move(notes));
+	// Print out the notes with the bar and beat that they start on.
+	for(const Note& n : index.getNotesInBars(grid, firstBar, lastBar)){
+		int64_t bar;
+		int beat;
+		grid.locate(n.getStartTick(), bar, beat);
+		cout << setw(6) << bar << ':' << beat << ' ' << n << '\n';
+	}
+	return 0;
+}
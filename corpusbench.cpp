@@ -0,0 +1,629 @@
+/*
+	Corpus Benchmark
+
+	This program reads every MIDI file in a corpus with every way that this
+	library has of reading notes, and reports how fast each one is for each
+	kind of file. Files are sorted into categories by their format, SMPTE
+	timing, how much of them is system exclusive data, and how many notes
+	they play per second.
+
+	Every backend and category is run in its own child process so that the
+	peak memory use and the count of allocations belong to that run alone.
+	The results can be saved as JSON and compared against an earlier run to
+	catch regressions.
+*/
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "FileList.h"
+#include "MidiReader.h"
+#include "Note.h"
+#include "SpscQueue.h"
+#include "musiccodes.h"
+using namespace std;
+using namespace MusicCodes;
+namespace {
+	// Every allocation made through operator new is counted so that changes that add allocations show up.
+	atomic<uint64_t> numAllocations(0);
+	atomic<uint64_t> numAllocatedBytes(0);
+}
+void* operator new(size_t size){
+	numAllocations.fetch_add(1, memory_order_relaxed);
+	numAllocatedBytes.fetch_add(size, memory_order_relaxed);
+	if(void* result = malloc(size ? size : 1)){
+		return result;
+	}
+	throw bad_alloc();
+}
+void operator delete(void* pointer) noexcept {
+	free(pointer);
+}
+namespace {
+	// The measurements of one backend over one category of files
+	struct Result {
+		string backend;
+		string category;
+		uint64_t files;
+		uint64_t bytes;
+		uint64_t notes;
+		// The time taken by the fastest pass over the files
+		double seconds;
+		long peakRssKilobytes;
+		// The allocations made during one pass over the files
+		uint64_t allocations;
+		uint64_t allocatedBytes;
+		double filesPerSecond() const {
+			return seconds > 0 ? files / seconds : 0;
+		}
+		double megabytesPerSecond() const {
+			return seconds > 0 ? bytes / seconds / 1e6 : 0;
+		}
+		double notesPerSecond() const {
+			return seconds > 0 ? notes / seconds : 0;
+		}
+	};
+	// What a child process sends back to the parent
+	struct Measurement {
+		uint64_t notes;
+		double seconds;
+		long peakRssKilobytes;
+		uint64_t allocations;
+		uint64_t allocatedBytes;
+	};
+	// A way of reading all of the notes out of a file. Returns the number of notes, or -1 on failure.
+	typedef int64_t (*Backend)(const string& path);
+	// Reads the notes with a MidiReader over an ifstream, the same way that the programs do.
+	int64_t readWithIstream(const string& path){
+		ifstream midifile(path);
+		MidiReader midiread(midifile);
+		if(!midiread){
+			return -1;
+		}
+		int64_t numNotes = 0;
+		while(midiread.getNextNote()){
+			++numNotes;
+		}
+		return numNotes;
+	}
+	// Records a checkpoint every bar of 4/4 and then reads the notes from the beginning through them.
+	// Multi-song files cannot have checkpoints, so they are read straight through like the other backends,
+	// which keeps every backend reading the same files.
+	int64_t readWithCheckpoints(const string& path){
+		ifstream midifile(path);
+		MidiReader midiread(midifile);
+		if(!midiread){
+			return -1;
+		}
+		if(midiread.buildCheckpoints(max(midiread.getTicksPerQuarterNote(500000) * 4, 1u))){
+			midiread.seekToTick(0);
+		}
+		int64_t numNotes = 0;
+		while(midiread.getNextNote()){
+			++numNotes;
+		}
+		return numNotes;
+	}
+	// Decodes the notes on another thread and passes them over in batches, like halfsteps -p does.
+	int64_t readPipelined(const string& path){
+		ifstream midifile(path);
+		MidiReader midiread(midifile);
+		if(!midiread){
+			return -1;
+		}
+		// An empty batch means that there are no more notes.
+		SpscQueue<vector<Note>> batches(16);
+		thread decoder([&]{
+			vector<Note> batch;
+			Note n = Note::InvalidNote();
+			while((n = midiread.getNextNote())){
+				batch.push_back(n);
+				if(batch.size() == 1024){
+					batches.push(move(batch));
+					batch = vector<Note>();
+				}
+			}
+			if(batch.size()){
+				batches.push(move(batch));
+			}
+			batches.push(vector<Note>());
+		});
+		int64_t numNotes = 0;
+		for(vector<Note> batch; (batch = batches.pop()).size(); ){
+			numNotes += batch.size();
+		}
+		decoder.join();
+		return numNotes;
+	}
+	// Maps the file into memory and decodes the notes through the C interface.
+	int64_t readWithCApi(const string& path){
+		int fd = open(path.c_str(), O_RDONLY);
+		if(fd < 0){
+			return -1;
+		}
+		mc_reader* reader;
+		int status = mc_open_fd(fd, &reader);
+		close(fd);
+		if(status != MC_OK){
+			return -1;
+		}
+		const size_t capacity = 4096;
+		vector<uint8_t> pitches(capacity);
+		vector<int64_t> startTicks(capacity);
+		mc_note_arrays arrays = {};
+		arrays.pitch = pitches.data();
+		arrays.start_tick = startTicks.data();
+		int64_t numNotes = 0;
+		ptrdiff_t count;
+		while((count = mc_decode_notes(reader, &arrays, capacity)) > 0){
+			numNotes += count;
+		}
+		mc_close(reader);
+		return count < 0 ? -1 : numNotes;
+	}
+	const struct {
+		const char* name;
+		Backend read;
+	} BACKENDS[] = {
+		{"istream", readWithIstream},
+		{"checkpoints", readWithCheckpoints},
+		{"pipelined", readPipelined},
+		{"mmap-c-api", readWithCApi}
+	};
+	// Files that play at least this many notes per second are counted as dense.
+	const double DENSE_NOTES_PER_SECOND = 20;
+	// Files that are at least this fraction system exclusive data are counted as sysex-heavy.
+	const double SYSEX_HEAVY_FRACTION = 0.25;
+	// Reads a variable-length quantity. Returns false if it runs past the end.
+	bool readVariableLength(const string& data, size_t& i, size_t end, uint64_t& value){
+		value = 0;
+		for(int length = 0; length < 4 && i < end; ++length){
+			uint8_t byte = data[i++];
+			value = value << 7 | (byte & 0x7F);
+			if(!(byte & 0x80)){
+				return true;
+			}
+		}
+		return false;
+	}
+	// Returns the number of bytes in the system exclusive events of every track.
+	uint64_t countSysexBytes(const string& data){
+		uint64_t sysexBytes = 0;
+		size_t chunk = 14;
+		while(chunk + 8 <= data.size()){
+			uint32_t length = (uint8_t)data[chunk + 4] << 24 | (uint8_t)data[chunk + 5] << 16 | (uint8_t)data[chunk + 6] << 8 | (uint8_t)data[chunk + 7];
+			size_t i = chunk + 8, end = min(data.size(), i + length);
+			if(data.compare(chunk, 4, "MTrk") == 0){
+				uint8_t runningStatus = 0;
+				uint64_t value;
+				while(i < end && readVariableLength(data, i, end, value) && i < end){
+					uint8_t status = data[i];
+					if(status & 0x80){
+						++i;
+					}else{
+						status = runningStatus;
+					}
+					if(status == 0xF0 || status == 0xF7){
+						if(!readVariableLength(data, i, end, value)){
+							break;
+						}
+						sysexBytes += value;
+						i += value;
+					}else if(status == 0xFF){
+						++i;
+						if(!readVariableLength(data, i, end, value)){
+							break;
+						}
+						i += value;
+					}else if(status >= 0x80){
+						runningStatus = status;
+						i += (status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0 ? 1 : 2;
+					}else{
+						// Data without any status to go with it
+						break;
+					}
+				}
+			}
+			chunk += 8 + (size_t)length;
+		}
+		return sysexBytes;
+	}
+	// Sorts a file into a category. Returns an empty string if the file cannot be read.
+	string categorize(const string& path, uint64_t& size){
+		ifstream file(path, ios::binary);
+		if(!file){
+			return "";
+		}
+		string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+		size = data.size();
+		mc_reader* reader;
+		if(mc_open_buffer(data.data(), data.size(), &reader) != MC_OK){
+			return "";
+		}
+		// Find out how many notes the file plays and how long it lasts.
+		const size_t capacity = 4096;
+		vector<int64_t> endTimes(capacity);
+		mc_note_arrays arrays = {};
+		arrays.end_us = endTimes.data();
+		uint64_t numNotes = 0;
+		int64_t lastEnd = 0;
+		ptrdiff_t count;
+		while((count = mc_decode_notes(reader, &arrays, capacity)) > 0){
+			numNotes += count;
+			lastEnd = max(lastEnd, *max_element(endTimes.begin(), endTimes.begin() + count));
+		}
+		mc_stats stats;
+		mc_get_stats(reader, &stats);
+		mc_close(reader);
+		if(count < 0){
+			return "";
+		}
+		if(stats.division < 0){
+			return "smpte";
+		}
+		if(countSysexBytes(data) >= SYSEX_HEAVY_FRACTION * data.size()){
+			return "sysex-heavy";
+		}
+		if(lastEnd > 0 && numNotes / (lastEnd * 1e-6) >= DENSE_NOTES_PER_SECOND){
+			return "dense";
+		}
+		return "format" + to_string(stats.format);
+	}
+	// Passes over small categories are repeated until they take at least this long, so that the timer can measure them.
+	const double MINIMUM_SECONDS = 0.05;
+	// Reads every file once. Returns false if any file could not be read.
+	bool readFiles(Backend backend, const vector<string>& files, uint64_t& numNotes){
+		numNotes = 0;
+		for(const string& path : files){
+			int64_t count = backend(path);
+			if(count < 0){
+				cerr << path << ": This file could not be read.\n";
+				return false;
+			}
+			numNotes += count;
+		}
+		return true;
+	}
+	// Reads every file with the backend several times and measures the fastest pass.
+	bool measure(Backend backend, const vector<string>& files, int numRepeats, Measurement& measurement){
+		// Count the allocations of the first pass, which also warms up the page cache.
+		uint64_t allocationsBefore = numAllocations, allocatedBytesBefore = numAllocatedBytes;
+		if(!readFiles(backend, files, measurement.notes)){
+			return false;
+		}
+		measurement.allocations = numAllocations - allocationsBefore;
+		measurement.allocatedBytes = numAllocatedBytes - allocatedBytesBefore;
+		for(int repeat = 0; repeat < numRepeats; ++repeat){
+			uint64_t numNotes;
+			int numPasses = 0;
+			double seconds;
+			auto start = chrono::steady_clock::now();
+			do{
+				if(!readFiles(backend, files, numNotes)){
+					return false;
+				}
+				++numPasses;
+				seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			}while(seconds < MINIMUM_SECONDS);
+			seconds /= numPasses;
+			if(!repeat || seconds < measurement.seconds){
+				measurement.seconds = seconds;
+			}
+		}
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		measurement.peakRssKilobytes = usage.ru_maxrss;
+		return true;
+	}
+	// Reads exactly length bytes unless the other end is closed first.
+	bool readAll(int fd, void* buffer, size_t length){
+		char* next = (char*)buffer;
+		while(length){
+			ssize_t count = read(fd, next, length);
+			if(count < 0 && errno == EINTR){
+				continue;
+			}
+			if(count <= 0){
+				return false;
+			}
+			next += count;
+			length -= count;
+		}
+		return true;
+	}
+	// Runs measure() in a child process so that its memory use and allocations are its own.
+	bool measureInChild(Backend backend, const vector<string>& files, int numRepeats, Measurement& measurement){
+		int fds[2];
+		if(pipe(fds) != 0){
+			return measure(backend, files, numRepeats, measurement);
+		}
+		pid_t child = fork();
+		if(child < 0){
+			close(fds[0]);
+			close(fds[1]);
+			return measure(backend, files, numRepeats, measurement);
+		}
+		if(!child){
+			close(fds[0]);
+			bool success = measure(backend, files, numRepeats, measurement) &&
+				write(fds[1], &measurement, sizeof(measurement)) == sizeof(measurement);
+			_exit(success ? 0 : 1);
+		}
+		close(fds[1]);
+		bool success = readAll(fds[0], &measurement, sizeof(measurement));
+		close(fds[0]);
+		int status;
+		waitpid(child, &status, 0);
+		return success && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+	void writeResults(ostream& os, const vector<Result>& results){
+		os << setprecision(12) << "{\n\t\"results\": [\n";
+		for(size_t i = 0; i < results.size(); ++i){
+			const Result& r = results[i];
+			os << "\t\t{\"backend\": \"" << r.backend << "\", \"category\": \"" << r.category << '"'
+				<< ", \"files\": " << r.files
+				<< ", \"bytes\": " << r.bytes
+				<< ", \"notes\": " << r.notes
+				<< ", \"seconds\": " << r.seconds
+				<< ", \"files_per_second\": " << r.filesPerSecond()
+				<< ", \"megabytes_per_second\": " << r.megabytesPerSecond()
+				<< ", \"notes_per_second\": " << r.notesPerSecond()
+				<< ", \"peak_rss_kilobytes\": " << r.peakRssKilobytes
+				<< ", \"allocations\": " << r.allocations
+				<< ", \"allocated_bytes\": " << r.allocatedBytes
+				<< '}' << (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		os << "\t]\n}\n";
+	}
+	// Reads the results that writeResults() wrote. This is not a general JSON parser: it expects
+	// every result to be an object of strings and numbers with no nested objects.
+	bool readResults(const string& path, vector<Result>& results){
+		ifstream file(path);
+		if(!file){
+			return false;
+		}
+		string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+		size_t i = text.find('[');
+		if(i == string::npos){
+			return false;
+		}
+		while((i = text.find('{', i)) != string::npos){
+			size_t end = text.find('}', i);
+			if(end == string::npos){
+				return false;
+			}
+			Result r = {};
+			size_t j = i + 1;
+			while((j = text.find('"', j)) < end){
+				size_t keyEnd = text.find('"', j + 1);
+				size_t value = text.find_first_not_of(" \t\r\n", text.find(':', keyEnd) + 1);
+				if(keyEnd >= end || value >= end){
+					return false;
+				}
+				string key = text.substr(j + 1, keyEnd - j - 1);
+				if(text[value] == '"'){
+					size_t valueEnd = text.find('"', value + 1);
+					if(valueEnd >= end){
+						return false;
+					}
+					(key == "backend" ? r.backend : r.category) = text.substr(value + 1, valueEnd - value - 1);
+					j = valueEnd + 1;
+					continue;
+				}
+				char* after;
+				double number = strtod(text.c_str() + value, &after);
+				if(key == "files"){
+					r.files = number;
+				}else if(key == "bytes"){
+					r.bytes = number;
+				}else if(key == "notes"){
+					r.notes = number;
+				}else if(key == "seconds"){
+					r.seconds = number;
+				}else if(key == "peak_rss_kilobytes"){
+					r.peakRssKilobytes = number;
+				}else if(key == "allocations"){
+					r.allocations = number;
+				}else if(key == "allocated_bytes"){
+					r.allocatedBytes = number;
+				}
+				// The rates are worked out again from the totals, so they are skipped.
+				j = after - text.c_str();
+			}
+			results.push_back(r);
+			i = end;
+		}
+		return true;
+	}
+	void printResults(const vector<Result>& results){
+		cout << left << setw(12) << "backend" << setw(12) << "category" << right
+			<< setw(7) << "files" << setw(10) << "MB/s" << setw(10) << "files/s" << setw(12) << "notes/s"
+			<< setw(12) << "peak KB" << setw(14) << "allocations" << '\n';
+		for(const Result& r : results){
+			cout << left << setw(12) << r.backend << setw(12) << r.category << right << fixed << setprecision(1)
+				<< setw(7) << r.files << setw(10) << r.megabytesPerSecond() << setw(10) << r.filesPerSecond()
+				<< setprecision(0) << setw(12) << r.notesPerSecond() << setw(12) << r.peakRssKilobytes
+				<< setw(14) << r.allocations << '\n';
+		}
+		cout.unsetf(ios::floatfield);
+		cout << setprecision(6);
+	}
+	// Compares the results against a baseline and prints every measurement that changed by more
+	// than the threshold, which is a fraction. Returns the number of regressions.
+	int compareResults(const vector<Result>& baseline, const vector<Result>& results, double threshold){
+		int numRegressions = 0;
+		// Prints a measurement if it changed enough to matter and counts it if it got worse.
+		auto check = [&](const Result& r, const char* name, double before, double after, bool higherIsBetter){
+			if(before <= 0){
+				return;
+			}
+			double change = (after - before) / before;
+			if(abs(change) <= threshold){
+				return;
+			}
+			bool worse = higherIsBetter ? change < 0 : change > 0;
+			numRegressions += worse;
+			cout << (worse ? "REGRESSION  " : "improvement ") << r.backend << ' ' << r.category << ' ' << name << ": "
+				<< before << " -> " << after << " (" << showpos << fixed << setprecision(1) << change * 100 << "%)\n"
+				<< noshowpos;
+			cout.unsetf(ios::floatfield);
+			cout << setprecision(6);
+		};
+		for(const Result& r : results){
+			auto b = find_if(baseline.begin(), baseline.end(), [&](const Result& b){
+				return b.backend == r.backend && b.category == r.category;
+			});
+			if(b == baseline.end()){
+				cout << "new         " << r.backend << ' ' << r.category << '\n';
+				continue;
+			}
+			// A different number of notes in the same files means that the reader changed what it reads.
+			if(b->files == r.files && b->bytes == r.bytes && b->notes != r.notes){
+				++numRegressions;
+				cout << "REGRESSION  " << r.backend << ' ' << r.category << " notes: " << b->notes << " -> " << r.notes << '\n';
+			}
+			// Files per second and notes per second change along with this, so they are not checked on their own.
+			check(r, "MB/s", b->megabytesPerSecond(), r.megabytesPerSecond(), true);
+			check(r, "peak KB", b->peakRssKilobytes, r.peakRssKilobytes, false);
+			// Allocations are compared per file so that adding files to the corpus does not count.
+			check(r, "allocations/file", (double)b->allocations / max(b->files, (uint64_t)1), (double)r.allocations / max(r.files, (uint64_t)1), false);
+			check(r, "allocated bytes/file", (double)b->allocatedBytes / max(b->files, (uint64_t)1), (double)r.allocatedBytes / max(r.files, (uint64_t)1), false);
+		}
+		for(const Result& b : baseline){
+			if(find_if(results.begin(), results.end(), [&](const Result& r){
+				return b.backend == r.backend && b.category == r.category;
+			}) == results.end()){
+				cout << "missing     " << b.backend << ' ' << b.category << '\n';
+			}
+		}
+		cout << numRegressions << " regressions beyond " << threshold * 100 << "%" << endl;
+		return numRegressions;
+	}
+}
+int main(int argc, char** argv){
+	int numRepeats = 3;
+	string outputPath, baselinePath;
+	double threshold = 0.1;
+	bool compareOnly = false;
+	// Read the options.
+	int option;
+	while((option = getopt(argc, argv, "b:cn:o:r:")) != -1){
+		switch(option){
+			case 'b':
+				baselinePath = optarg;
+				break;
+			case 'c':
+				compareOnly = true;
+				break;
+			case 'n':
+				numRepeats = max(atoi(optarg), 1);
+				break;
+			case 'o':
+				outputPath = optarg;
+				break;
+			case 'r':
+				threshold = atof(optarg) / 100;
+				break;
+			default:
+				return 1;
+		}
+	}
+	if(optind >= argc || (compareOnly && argc - optind != 2)){
+		cout << "Corpus Benchmark by David Tsai\n"
+			<< "This program reads a corpus of MIDI files with every backend and reports the\n"
+			<< "speed, peak memory, and allocations for each category of file.\n\n"
+			<< "Usage:\n"
+			<< "  corpusbench [-n N] [-o RESULTS] [-b BASELINE] [-r PERCENT] PATH...\n"
+			<< "  corpusbench -c [-r PERCENT] BASELINE RESULTS\n\n"
+			<< "Options:\n"
+			<< "  -n N         Read every file N times and keep the fastest pass (default: 3).\n"
+			<< "  -o RESULTS   Save the results as JSON.\n"
+			<< "  -b BASELINE  Compare the results against a saved baseline.\n"
+			<< "  -c           Only compare two saved results files.\n"
+			<< "  -r PERCENT   How much a measurement may get worse before it counts as a\n"
+			<< "               regression (default: 10).\n\n"
+			<< "Pass in paths to MIDI files or directories of MIDI files. The exit status is 2\n"
+			<< "if there were any regressions." << endl;
+		return 0;
+	}
+	if(compareOnly){
+		vector<Result> baseline, results;
+		if(!readResults(argv[optind], baseline) || !readResults(argv[optind + 1], results)){
+			cerr << "The results could not be read.\n";
+			return 1;
+		}
+		return compareResults(baseline, results, threshold) ? 2 : 0;
+	}
+	// Sort the files into categories.
+	vector<string> files;
+	for(int i = optind; i < argc; ++i){
+		findFiles(argv[i], files);
+	}
+	int numFailures = 0;
+	map<string, vector<string>> categories;
+	map<string, uint64_t> categoryBytes;
+	for(const string& path : files){
+		uint64_t size = 0;
+		string category = categorize(path, size);
+		if(category.empty()){
+			cerr << path << ": This is not a supported MIDI file.\n";
+			++numFailures;
+			continue;
+		}
+		categories[category].push_back(path);
+		categoryBytes[category] += size;
+	}
+	// Measure every backend on every category.
+	vector<Result> results;
+	for(const auto& backend : BACKENDS){
+		for(const auto& category : categories){
+			Measurement m;
+			if(!measureInChild(backend.read, category.second, numRepeats, m)){
+				cerr << backend.name << ' ' << category.first << ": The measurement failed.\n";
+				++numFailures;
+				continue;
+			}
+			results.push_back({
+				backend.name, category.first,
+				category.second.size(), categoryBytes[category.first], m.notes,
+				m.seconds, m.peakRssKilobytes, m.allocations, m.allocatedBytes
+			});
+		}
+	}
+	printResults(results);
+	if(outputPath.size()){
+		ofstream output(outputPath);
+		writeResults(output, results);
+		if(!output){
+			cerr << outputPath << ": The results could not be saved.\n";
+			++numFailures;
+		}
+	}
+	if(baselinePath.size()){
+		vector<Result> baseline;
+		if(!readResults(baselinePath, baseline)){
+			cerr << baselinePath << ": The baseline could not be read.\n";
+			return 1;
+		}
+		if(compareResults(baseline, results, threshold)){
+			return 2;
+		}
+	}
+	return numFailures ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+/*
+	Duplicate Finder
+
+	This program finds MIDI files that contain the same music, even if one was
+	transposed or retimed. Every file gets a Fingerprint, fingerprints that
+	share a band are compared, and files whose fingerprints are similar enough
+	are grouped into clusters. Only the files in the same band bucket are ever
+	compared, so the work grows with the number of files instead of its square.
+*/
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "FileList.h"
+#include "Fingerprint.h"
+#include "MidiReader.h"
+#include "Note.h"
+using namespace std;
+using namespace MusicCodes;
+namespace {
+	// Reads all of the notes of the file and returns their fingerprint, or NULL if the file could not be read.
+	unique_ptr<Fingerprint> fingerprintFile(const string& path){
+		ifstream midifile(path);
+		if(!midifile){
+			return NULL;
+		}
+		MidiReader midiread(midifile);
+		if(!midiread){
+			return NULL;
+		}
+		vector<Note> notes;
+		Note n = Note::InvalidNote();
+		while((n = midiread.getNextNote())){
+			notes.push_back(n);
+		}
+		unique_ptr<Fingerprint> result(new Fingerprint(move(notes)));
+		if(!*result){
+			return NULL;
+		}
+		return result;
+	}
+	// Finds the representative of a set in a union-find forest, compressing the path along the way.
+	size_t findSet(vector<size_t>& parents, size_t i){
+		while(parents[i] != i){
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	}
+}
+int main(int argc, char** argv){
+	double threshold = 0.5;
+	unsigned int numThreads = thread::hardware_concurrency();
+	// Read the options.
+	int option;
+	while((option = getopt(argc, argv, "s:t:")) != -1){
+		switch(option){
+			case 's':
+				threshold = atof(optarg);
+				break;
+			case 't':
+				numThreads = atoi(optarg);
+				break;
+			default:
+				return 1;
+		}
+	}
+	// This program expects file paths to be passed in as arguments.
+	// Check whether any arguments were passed in.
+	if(optind >= argc){
+		cout << "Duplicate Finder by David Tsai\n"
+			<< "This program finds MIDI files that contain the same music, even if they were\n"
+			<< "transposed or retimed, and prints them in clusters.\n\n"
+			<< "Options:\n"
+			<< "  -s SIMILARITY  How similar two files must be to be duplicates, from 0 to 1\n"
+			<< "                 (default: 0.5).\n"
+			<< "  -t N           Read N files at the same time (default: one per CPU).\n\n"
+			<< "Pass in one or more paths to MIDI files or directories of MIDI files." << endl;
+		return 0;
+	}
+	if(!numThreads){
+		numThreads = 1;
+	}
+	vector<string> files;
+	for(int i = optind; i < argc; ++i){
+		findFiles(argv[i], files);
+	}
+	// Fingerprint all of the files on several threads. Each thread takes the next file that nobody has taken.
+	vector<unique_ptr<Fingerprint>> fingerprints(files.size());
+	atomic<size_t> nextFile(0);
+	vector<thread> threads;
+	for(unsigned int t = 0; t < numThreads; ++t){
+		threads.emplace_back([&]{
+			size_t i;
+			while((i = nextFile++) < files.size()){
+				fingerprints[i] = fingerprintFile(files[i]);
+			}
+		});
+	}
+	for(thread& t : threads){
+		t.join();
+	}
+	int numFailures = 0;
+	for(size_t i = 0; i < files.size(); ++i){
+		if(!fingerprints[i]){
+			cerr << files[i] << ": This file is not a supported MIDI file or has too few notes.\n";
+			++numFailures;
+		}
+	}
+	// Join the files that land in the same bucket of any band and are similar enough.
+	// Every file in a bucket is only compared to the first one, which keeps crowded buckets from
+	// taking quadratic time. Copies that are missed this way are usually joined through another band.
+	vector<size_t> parents(files.size());
+	for(size_t i = 0; i < files.size(); ++i){
+		parents[i] = i;
+	}
+	for(int band = 0; band < Fingerprint::NUM_BANDS; ++band){
+		unordered_map<uint64_t, size_t> firstInBucket;
+		for(size_t i = 0; i < files.size(); ++i){
+			if(!fingerprints[i]){
+				continue;
+			}
+			auto inserted = firstInBucket.emplace(fingerprints[i]->getBandHash(band), i);
+			if(inserted.second){
+				continue;
+			}
+			size_t first = inserted.first->second;
+			size_t a = findSet(parents, first), b = findSet(parents, i);
+			if(a != b && fingerprints[first]->similarity(*fingerprints[i]) >= threshold){
+				parents[b] = a;
+			}
+		}
+	}
+	// Print out every cluster that has more than one file.
+	map<size_t, vector<size_t>> clusters;
+	for(size_t i = 0; i < files.size(); ++i){
+		if(fingerprints[i]){
+			clusters[findSet(parents, i)].push_back(i);
+		}
+	}
+	int numClusters = 0;
+	for(auto& cluster : clusters){
+		if(cluster.second.size() < 2){
+			continue;
+		}
+		cout << "Cluster " << ++numClusters << ":\n";
+		for(size_t i : cluster.second){
+			cout << "  " << files[i] << '\n';
+		}
+	}
+	cout << numClusters << " clusters of duplicates among " << files.size() << " files" << endl;
+	return numFailures;
+}
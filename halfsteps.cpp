@@ -1,28 +1,147 @@
 #include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 #include "Note.h"
 #include "MidiReader.h"
+#include "SpscQueue.h"
 using namespace std;
 using namespace MusicCodes;
+namespace {
+	// Prints every note and then the intervals between them, all on this thread.
+	void printNotes(MidiReader& midiread){
+		// Handle the first note.
+		Note n = midiread.getNextNote();
+		int count = 1;
+		cout << setw(4) << count << '.' << ' ' << n << endl;
+		// Create a vector to hold the intervals between notes.
+		auto lastPitch = n.getPitch();
+		vector<int> intervals;
+		// Iterate over the other notes.
+		while((n = midiread.getNextNote())){
+			// Print the note.
+			cout << setw(4) << ++count << '.' << ' ' << n << endl;
+			// Save the interval from the last pitch.
+			intervals.push_back(n.getPitch() - lastPitch);
+			lastPitch = n.getPitch();
+		}
+		// Print out the intervals as numbers of halfs steps.
+		cout << "Sequence of half steps:";
+		for(int s : intervals){
+			cout << ' ' << s;
+		}
+		cout << endl;
+	}
+	// The notes that are passed from one stage of the pipeline to the next at once,
+	// along with the intervals that lead up to them once they have been analyzed
+	struct Batch {
+		vector<Note> notes;
+		vector<int> intervals;
+	};
+	const size_t BATCH_SIZE = 1024;
+	const size_t BATCHES_IN_FLIGHT = 16;
+	// Prints the same thing as printNotes(), but reads the notes, computes the intervals, and formats
+	// the output on three threads at the same time. The stages pass batches of notes through queues.
+	// An empty batch tells the next stage that there are no more notes.
+	void printNotesPipelined(MidiReader& midiread){
+		SpscQueue<Batch> decoded(BATCHES_IN_FLIGHT), analyzed(BATCHES_IN_FLIGHT);
+		thread decoder([&midiread, &decoded]{
+			// The first note is printed even if it is invalid, just like printNotes() does.
+			Batch batch;
+			batch.notes.push_back(midiread.getNextNote());
+			if(batch.notes.back()){
+				Note n = Note::InvalidNote();
+				while((n = midiread.getNextNote())){
+					batch.notes.push_back(n);
+					if(batch.notes.size() == BATCH_SIZE){
+						decoded.push(move(batch));
+						batch = Batch();
+					}
+				}
+			}
+			if(batch.notes.size()){
+				decoded.push(move(batch));
+			}
+			decoded.push(Batch());
+		});
+		thread analyzer([&decoded, &analyzed]{
+			bool first = true;
+			uint8_t lastPitch = 0;
+			while(true){
+				Batch batch = decoded.pop();
+				for(const Note& n : batch.notes){
+					if(!first){
+						batch.intervals.push_back(n.getPitch() - lastPitch);
+					}
+					first = false;
+					lastPitch = n.getPitch();
+				}
+				bool done = batch.notes.empty();
+				analyzed.push(move(batch));
+				if(done){
+					break;
+				}
+			}
+		});
+		// Format the notes on this thread and write each batch at once.
+		int count = 0;
+		vector<int> intervals;
+		ostringstream text;
+		while(true){
+			Batch batch = analyzed.pop();
+			if(batch.notes.empty()){
+				break;
+			}
+			text.str("");
+			for(const Note& n : batch.notes){
+				text << setw(4) << ++count << '.' << ' ' << n << '\n';
+			}
+			cout << text.str() << flush;
+			intervals.insert(intervals.end(), batch.intervals.begin(), batch.intervals.end());
+		}
+		decoder.join();
+		analyzer.join();
+		// Print out the intervals as numbers of halfs steps.
+		cout << "Sequence of half steps:";
+		for(int s : intervals){
+			cout << ' ' << s;
+		}
+		cout << endl;
+	}
+}
 int main(int argc, char** argv){
+	bool pipelined = false;
+	// Read the options.
+	int option;
+	while((option = getopt(argc, argv, "p")) != -1){
+		switch(option){
+			case 'p':
+				pipelined = true;
+				break;
+			default:
+				return 1;
+		}
+	}
 	// This program expects file paths to be passed in as arguments.
 	// Check whether any arguments were passed in.
-	if(argc < 2){
+	if(optind >= argc){
 		cout << "Half Steps by David Tsai\n"
 			<< "This program reads a MIDI file and then prints out the number of half steps\n"
 			<< "between every note. If the MIDI file has N notes, then N-1 numbers will be\n"
 			<< "printed.\n"
+			<< "Pass -p to read, analyze, and print the notes on separate threads.\n"
 			<< "Pass in one or more paths to MIDI files." << endl;
 		return 0;
 	}
 	// Loop through the arguments.
 	int numFailures = 0;
-	for(int i = 1; i < argc; ++i){
+	for(int i = optind; i < argc; ++i){
 		// Print out the argument so that the user knows which one is being processed.
-		if(argc > 2){
-			if(i > 1){
+		if(argc - optind > 1){
+			if(i > optind){
 				cout << '\n';
 			}
 			cout << "File: " << argv[i] << endl;
@@ -43,27 +162,11 @@ int main(int argc, char** argv){
 		}
 		// Print out a summary of the MIDI file.
 		cout << "MIDI: " << midiread << endl;
-		// Handle the first note.
-		Note n = midiread.getNextNote();
-		int count = 1;
-		cout << setw(4) << count << '.' << ' ' << n << endl;
-		// Create a vector to hold the intervals between notes.
-		auto lastPitch = n.getPitch();
-		vector<int> intervals;
-		// Iterate over the other notes.
-		while((n = midiread.getNextNote())){
-			// Print the note.
-			cout << setw(4) << ++count << '.' << ' ' << n << endl;
-			// Save the interval from the last pitch.
-			intervals.push_back(n.getPitch() - lastPitch);
-			lastPitch = n.getPitch();
+		if(pipelined){
+			printNotesPipelined(midiread);
+		}else{
+			printNotes(midiread);
 		}
-		// Print out the intervals as numbers of halfs steps.
-		cout << "Sequence of half steps:";
-		for(int s : intervals){
-			cout << ' ' << s;
-		}
-		cout << endl;
 	}
 	return numFailures;
 }
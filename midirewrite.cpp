@@ -0,0 +1,73 @@
+/*
+	MIDI Rewrite
+
+	This program transposes notes, remaps channels, and scales velocities in
+	MIDI files. The notes are patched in place instead of being decoded and
+	re-encoded, so rewriting a large library takes about as long as copying it.
+*/
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "MidiRewriter.h"
+using namespace std;
+using namespace MusicCodes;
+int main(int argc, char** argv){
+	MidiRewriter rewriter;
+	// Read the options.
+	int option;
+	while((option = getopt(argc, argv, "t:v:c:")) != -1){
+		switch(option){
+			case 't':
+				rewriter.setTranspose(atoi(optarg));
+				break;
+			case 'v':
+				rewriter.setVelocityScale(atof(optarg));
+				break;
+			case 'c': {
+				// The channels are given as FROM:TO and numbered from 1 to 16, like most music software does.
+				string mapping(optarg);
+				size_t colon = mapping.find(':');
+				int from = atoi(mapping.c_str());
+				int to = colon == string::npos ? -1 : atoi(mapping.c_str() + colon + 1);
+				if(from < 1 || from > 16 || to < 0 || to > 16){
+					cerr << "Channel mappings look like 3:5 (or 3:0 to drop channel 3).\n";
+					return 1;
+				}
+				rewriter.mapChannel(from - 1, to - 1);
+				break;
+			}
+			default:
+				return 1;
+		}
+	}
+	// This program expects file paths to be passed in as arguments.
+	// Check whether any arguments were passed in.
+	if(optind >= argc){
+		cout << "MIDI Rewrite by David Tsai\n"
+			<< "This program rewrites the notes in MIDI files. The rewritten file will be\n"
+			<< "placed in the same directory as the input MIDI file.\n\n"
+			<< "Options:\n"
+			<< "  -t N        Transpose by N half steps. Notes that would leave the MIDI\n"
+			<< "              range are folded back into it by octaves.\n"
+			<< "  -v FACTOR   Multiply note velocities by FACTOR.\n"
+			<< "  -c FROM:TO  Move channel FROM to channel TO (1-16). If TO is 0, the\n"
+			<< "              events on channel FROM are dropped.\n\n"
+			<< "Pass in one or more paths to MIDI files." << endl;
+		return 0;
+	}
+	// Loop through the arguments.
+	int numFailures = 0;
+	for(int i = optind; i < argc; ++i){
+		string output = string(argv[i]) + ".rewritten.mid";
+		if(!rewriter.rewriteFile(argv[i], output)){
+			cerr << argv[i] << ": This file could not be rewritten.\n";
+			++numFailures;
+			continue;
+		}
+		cout << output << ": " << rewriter.getEventsPatched() << " events in "
+			<< rewriter.getTracksPatched() << " tracks patched, "
+			<< rewriter.getTracksReencoded() << " tracks re-encoded\n";
+	}
+	return numFailures;
+}
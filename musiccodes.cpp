@@ -0,0 +1,211 @@
+#include <istream>
+#include <new>
+#include <streambuf>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MidiReader.h"
+#include "musiccodes.h"
+using namespace std;
+using namespace MusicCodes;
+namespace {
+	// A streambuf that reads straight out of a block of memory without copying it
+	class MemoryBuffer : public streambuf {
+	public:
+		MemoryBuffer(const char* data, size_t length){
+			// The get area is never written to, so casting away const is safe.
+			char* begin = const_cast<char*>(data);
+			setg(begin, begin, begin + length);
+		}
+	protected:
+		pos_type seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which) override {
+			off_type base;
+			switch(dir){
+				case ios_base::beg:
+					base = 0;
+					break;
+				case ios_base::cur:
+					base = gptr() - eback();
+					break;
+				default:
+					base = egptr() - eback();
+			}
+			// Seeking anywhere outside of the data fails.
+			if(off < -base || base + off > egptr() - eback()){
+				return pos_type(off_type(-1));
+			}
+			setg(eback(), eback() + base + off, egptr());
+			return pos_type(base + off);
+		}
+		pos_type seekpos(pos_type pos, ios_base::openmode which) override {
+			return seekoff(off_type(pos), ios_base::beg, which);
+		}
+	};
+}
+struct mc_reader {
+	mc_reader(const char* data, size_t length) : buffer(data, length), stream(&buffer), reader(stream), length(length), notesDecoded(0), finished(false), mapping(NULL) {}
+	~mc_reader(){
+		if(mapping){
+			munmap(mapping, length);
+		}
+	}
+	MemoryBuffer buffer;
+	istream stream;
+	MidiReader reader;
+	size_t length;
+	uint64_t notesDecoded;
+	// Whether the last note has been decoded
+	bool finished;
+	// The memory that was mapped by mc_open_fd(), if any
+	void* mapping;
+	// The data that was read by mc_open_fd() if the file descriptor could not be mapped
+	vector<char> copy;
+};
+namespace {
+	// Opens a reader over the data and checks that it is a MIDI file.
+	int openReader(const char* data, size_t length, mc_reader** reader){
+		try {
+			*reader = new mc_reader(data, length);
+		}catch(const bad_alloc&){
+			return MC_ERROR_OUT_OF_MEMORY;
+		}catch(...){
+			return MC_ERROR_INTERNAL;
+		}
+		if(!(*reader)->reader){
+			delete *reader;
+			*reader = NULL;
+			return MC_ERROR_NOT_MIDI;
+		}
+		return MC_OK;
+	}
+}
+extern "C" {
+	uint32_t mc_abi_version(void){
+		return MC_ABI_VERSION;
+	}
+	const char* mc_strerror(int status){
+		switch(status){
+			case MC_OK:
+				return "success";
+			case MC_ERROR_INVALID_ARGUMENT:
+				return "invalid argument";
+			case MC_ERROR_IO:
+				return "input could not be read";
+			case MC_ERROR_NOT_MIDI:
+				return "not a supported MIDI file";
+			case MC_ERROR_OUT_OF_MEMORY:
+				return "out of memory";
+			case MC_ERROR_INTERNAL:
+				return "internal error";
+			default:
+				return "unknown error";
+		}
+	}
+	int mc_open_buffer(const void* data, size_t length, mc_reader** reader){
+		if(!reader || (!data && length)){
+			return MC_ERROR_INVALID_ARGUMENT;
+		}
+		return openReader(static_cast<const char*>(data), length, reader);
+	}
+	int mc_open_fd(int fd, mc_reader** reader){
+		if(!reader){
+			return MC_ERROR_INVALID_ARGUMENT;
+		}
+		*reader = NULL;
+		struct stat st;
+		if(fstat(fd, &st) != 0){
+			return MC_ERROR_IO;
+		}
+		if(S_ISREG(st.st_mode) && st.st_size > 0){
+			// Map regular files instead of copying them. The mapping stays valid after the file descriptor is closed.
+			void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapping != MAP_FAILED){
+				int status = openReader(static_cast<const char*>(mapping), st.st_size, reader);
+				if(status != MC_OK){
+					munmap(mapping, st.st_size);
+					return status;
+				}
+				(*reader)->mapping = mapping;
+				return MC_OK;
+			}
+		}
+		// Pipes and sockets cannot be mapped, so read everything into memory.
+		vector<char> copy;
+		try {
+			char chunk[65536];
+			ssize_t n;
+			while((n = read(fd, chunk, sizeof(chunk))) > 0){
+				copy.insert(copy.end(), chunk, chunk + n);
+			}
+			if(n < 0){
+				return MC_ERROR_IO;
+			}
+		}catch(const bad_alloc&){
+			return MC_ERROR_OUT_OF_MEMORY;
+		}
+		// The vector's data does not move when the vector itself is moved.
+		int status = openReader(copy.data(), copy.size(), reader);
+		if(status == MC_OK){
+			(*reader)->copy = move(copy);
+		}
+		return status;
+	}
+	ptrdiff_t mc_decode_notes(mc_reader* reader, const mc_note_arrays* notes, size_t capacity){
+		if(!reader || !notes){
+			return MC_ERROR_INVALID_ARGUMENT;
+		}
+		size_t count = 0;
+		try {
+			while(count < capacity && !reader->finished){
+				Note n = reader->reader.getNextNote();
+				if(!n){
+					reader->finished = true;
+					break;
+				}
+				if(notes->pitch){
+					notes->pitch[count] = n.getPitch();
+				}
+				if(notes->duration){
+					notes->duration[count] = n.getDuration();
+				}
+				if(notes->dots){
+					notes->dots[count] = n.getDots();
+				}
+				if(notes->start_tick){
+					notes->start_tick[count] = n.getStartTick();
+				}
+				if(notes->end_tick){
+					notes->end_tick[count] = n.getEndTick();
+				}
+				if(notes->start_us){
+					notes->start_us[count] = n.getStartMicroseconds();
+				}
+				if(notes->end_us){
+					notes->end_us[count] = n.getEndMicroseconds();
+				}
+				++count;
+			}
+		}catch(const bad_alloc&){
+			return MC_ERROR_OUT_OF_MEMORY;
+		}catch(...){
+			return MC_ERROR_INTERNAL;
+		}
+		reader->notesDecoded += count;
+		return count;
+	}
+	int mc_get_stats(const mc_reader* reader, mc_stats* stats){
+		if(!reader || !stats){
+			return MC_ERROR_INVALID_ARGUMENT;
+		}
+		stats->bytes = reader->length;
+		stats->notes_decoded = reader->notesDecoded;
+		stats->format = reader->reader.getFormat();
+		stats->tracks = reader->reader.getNumTracks();
+		stats->division = reader->reader.getDivision();
+		return MC_OK;
+	}
+	void mc_close(mc_reader* reader){
+		delete reader;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+	The C interface to libmusiccodes.
+
+	This lets programs in other languages read the notes out of MIDI files
+	in-process. A reader is opened over a buffer or a file descriptor, and then
+	the notes are decoded in batches straight into arrays that the caller owns.
+
+	Every function returns one of the MC_* status codes (or a count of notes,
+	which is never negative) and never throws. Structures are only ever added
+	to at the end, and MC_ABI_VERSION is increased whenever that happens.
+*/
+#ifndef INCLUDE_MUSIC_CODES_C_API
+#define INCLUDE_MUSIC_CODES_C_API 1
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define MC_ABI_VERSION 1
+enum mc_status {
+	MC_OK = 0,
+	// A required pointer was NULL.
+	MC_ERROR_INVALID_ARGUMENT = -1,
+	// The file descriptor could not be read.
+	MC_ERROR_IO = -2,
+	// The data does not start with a supported MIDI header.
+	MC_ERROR_NOT_MIDI = -3,
+	MC_ERROR_OUT_OF_MEMORY = -4,
+	MC_ERROR_INTERNAL = -5
+};
+// An open MIDI file. The fields are private.
+typedef struct mc_reader mc_reader;
+// Arrays that decoded notes are written into. Note i goes into element i of every array.
+// Any of the pointers may be NULL if the caller does not need that field.
+typedef struct mc_note_arrays {
+	// The MIDI pitch number
+	uint8_t* pitch;
+	// The duration, expressed as an exponent of 2. For example, a quarter note is -2.
+	int8_t* duration;
+	// The number of dots, each of which multiplies the duration by 1.5
+	uint8_t* dots;
+	// The times that the note started and stopped, in ticks and in microseconds
+	int64_t* start_tick;
+	int64_t* end_tick;
+	int64_t* start_us;
+	int64_t* end_us;
+} mc_note_arrays;
+typedef struct mc_stats {
+	// The size of the MIDI data in bytes
+	uint64_t bytes;
+	// The number of notes that have been decoded so far
+	uint64_t notes_decoded;
+	// The MIDI format: 0 for single track, 1 for multi-track, 2 for multi-song
+	uint32_t format;
+	// The number of tracks that the header announces
+	uint32_t tracks;
+	// The timing division. A negative value means SMPTE timing.
+	int32_t division;
+} mc_stats;
+// Returns MC_ABI_VERSION as it was when the library was built.
+uint32_t mc_abi_version(void);
+// Returns a description of a status code.
+const char* mc_strerror(int status);
+// Opens MIDI data that is already in memory. The data is not copied, so it must stay
+// valid until mc_close() is called.
+int mc_open_buffer(const void* data, size_t length, mc_reader** reader);
+// Opens the MIDI data that can be read from a file descriptor. Regular files are mapped
+// into memory instead of being copied. The file descriptor is not closed and can be
+// closed as soon as this function returns. Like any mapping, a file that is truncated
+// while the reader is open raises SIGBUS, so read files that other processes may change
+// into memory and use mc_open_buffer() instead.
+int mc_open_fd(int fd, mc_reader** reader);
+// Decodes up to capacity notes into the arrays, continuing from where the last call left off.
+// Returns the number of notes that were written, which is 0 once every note has been decoded.
+ptrdiff_t mc_decode_notes(mc_reader* reader, const mc_note_arrays* notes, size_t capacity);
+int mc_get_stats(const mc_reader* reader, mc_stats* stats);
+// Closes the reader. Passing NULL does nothing.
+void mc_close(mc_reader* reader);
+#ifdef __cplusplus
+}
+#endif
+#endif
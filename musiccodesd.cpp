@@ -0,0 +1,587 @@
+/*
+	Music Codes Daemon
+
+	This program keeps running in the background and reads MIDI files for
+	other programs over a Unix domain socket, so that they do not have to pay
+	for starting up a process and reading a cold file every time. The notes of
+	every file that is read by path are kept in a cache until the file changes
+	or the cache gets full. The protocol is described in musiccodesd.h.
+
+	Client sockets never block. The epoll loop collects each request, however
+	slowly it arrives, and a worker only gets a connection once the whole
+	request is there. Responses that do not fit in the socket are finished by
+	the epoll loop, so slow clients never hold a worker. The memory limit
+	covers the cache, the copies of files being decoded, and the note tables
+	that are still being sent.
+*/
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "musiccodes.h"
+#include "musiccodesd.h"
+using namespace std;
+namespace {
+	// The path of the socket, so that it can be removed when the daemon is stopped
+	char socketPath[sizeof(sockaddr_un::sun_path)];
+	void handleStopSignal(int){
+		unlink(socketPath);
+		_exit(0);
+	}
+	void closeIfOpen(int fd){
+		if(fd >= 0){
+			close(fd);
+		}
+	}
+	using NoteTable = shared_ptr<const vector<mcd_note>>;
+	// A least-recently-used cache of note tables. It also keeps track of all of the memory that
+	// the daemon uses for files and note tables, and forgets tables when more memory is needed.
+	class NoteCache {
+	public:
+		NoteCache(size_t capacityBytes) : capacityBytes(capacityBytes), usedBytes(0) {}
+		// Returns the note table for the key, or NULL if it is not in the cache.
+		NoteTable get(const string& key){
+			lock_guard<mutex> lock(m);
+			auto found = index.find(key);
+			if(found == index.end()){
+				return NULL;
+			}
+			// Move the entry to the front because it was just used.
+			entries.splice(entries.begin(), entries, found->second);
+			return found->second->second;
+		}
+		void put(const string& key, NoteTable notes){
+			lock_guard<mutex> lock(m);
+			auto found = index.find(key);
+			if(found != index.end()){
+				entries.erase(found->second);
+				index.erase(found);
+			}
+			entries.emplace_front(key, notes);
+			index[key] = entries.begin();
+		}
+		// Sets aside memory, forgetting the least recently used tables until it fits.
+		// Returns false if it does not fit even after the whole cache is forgotten.
+		bool reserve(size_t bytes){
+			while(true){
+				size_t used = usedBytes;
+				if(used + bytes <= capacityBytes){
+					if(usedBytes.compare_exchange_weak(used, used + bytes)){
+						return true;
+					}
+					continue;
+				}
+				NoteTable forgotten;
+				{
+					lock_guard<mutex> lock(m);
+					if(entries.empty()){
+						return false;
+					}
+					forgotten = move(entries.back().second);
+					index.erase(entries.back().first);
+					entries.pop_back();
+				}
+				// The table gives its memory back here, unless a response is still sending it.
+			}
+		}
+		void release(size_t bytes){
+			usedBytes -= bytes;
+		}
+	private:
+		mutex m;
+		size_t capacityBytes;
+		// The memory used by every note table that is still alive and every file being decoded
+		atomic<size_t> usedBytes;
+		// The most recently used entry is at the front.
+		list<pair<string, NoteTable>> entries;
+		unordered_map<string, list<pair<string, NoteTable>>::iterator> index;
+	};
+	// Memory set aside in a NoteCache, which is given back when this is destroyed
+	class Reservation {
+	public:
+		Reservation(NoteCache& cache) : cache(cache), bytes(0) {}
+		~Reservation(){
+			cache.release(bytes);
+		}
+		// Grows the reservation to the number of bytes. Returns false if there is not enough memory.
+		bool growTo(size_t total){
+			if(total > bytes){
+				if(!cache.reserve(total - bytes)){
+					return false;
+				}
+				bytes = total;
+			}
+			return true;
+		}
+		// Hands the memory over to a note table, which gives it back when the table is freed.
+		NoteTable adopt(vector<mcd_note>* table){
+			size_t tableBytes = bytes;
+			bytes = 0;
+			NoteCache* owner = &cache;
+			return NoteTable(table, [owner, tableBytes](const vector<mcd_note>* t){
+				delete t;
+				owner->release(tableBytes);
+			});
+		}
+	private:
+		NoteCache& cache;
+		size_t bytes;
+	};
+	// A connection to a client. Only one thread uses a connection at a time: the epoll loop while
+	// the request or response is waiting on the client, and a worker while the request is answered.
+	struct Connection {
+		Connection(int fd) : fd(fd), requestBytes(0), attached(-1), pathBytes(0), responseBytes(0), sending(false) {}
+		~Connection(){
+			close(fd);
+			closeIfOpen(attached);
+		}
+		int fd;
+		// The request as it has been received so far
+		mcd_request request;
+		size_t requestBytes;
+		int attached;
+		string path;
+		size_t pathBytes;
+		// The response as it has been sent so far
+		mcd_response response;
+		NoteTable notes;
+		size_t responseBytes;
+		bool sending;
+	};
+	enum Progress {
+		// The request was received or the response was sent.
+		DONE,
+		// The client has to be waited for.
+		WAITING,
+		// The client disconnected or broke the protocol, so the connection should be closed.
+		FAILED
+	};
+	// Receives as much of the request as the client has sent.
+	Progress receiveRequest(Connection& c){
+		while(c.requestBytes < sizeof(c.request)){
+			iovec iov = {(char*)&c.request + c.requestBytes, sizeof(c.request) - c.requestBytes};
+			char control[CMSG_SPACE(sizeof(int))];
+			msghdr message;
+			memset(&message, 0, sizeof(message));
+			message.msg_iov = &iov;
+			message.msg_iovlen = 1;
+			message.msg_control = control;
+			message.msg_controllen = sizeof(control);
+			ssize_t n = recvmsg(c.fd, &message, MSG_CMSG_CLOEXEC);
+			if(n < 0 && errno == EINTR){
+				continue;
+			}
+			if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return WAITING;
+			}
+			if(n <= 0){
+				return FAILED;
+			}
+			for(cmsghdr* cm = CMSG_FIRSTHDR(&message); cm; cm = CMSG_NXTHDR(&message, cm)){
+				if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS){
+					int fd;
+					memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+					// Only one file descriptor is expected per request.
+					if(c.attached >= 0){
+						close(fd);
+						return FAILED;
+					}
+					c.attached = fd;
+				}
+			}
+			c.requestBytes += n;
+			if(c.requestBytes == sizeof(c.request)){
+				if(c.request.magic != MCD_MAGIC){
+					return FAILED;
+				}
+				if(c.request.type == MCD_REQUEST_PATH){
+					if(c.request.path_length > PATH_MAX){
+						return FAILED;
+					}
+					c.path.assign(c.request.path_length, '\0');
+				}else if(c.request.type != MCD_REQUEST_FD || c.attached < 0){
+					return FAILED;
+				}
+			}
+		}
+		if(c.request.type == MCD_REQUEST_FD){
+			return DONE;
+		}
+		while(c.pathBytes < c.path.size()){
+			ssize_t n = read(c.fd, &c.path[c.pathBytes], c.path.size() - c.pathBytes);
+			if(n < 0 && errno == EINTR){
+				continue;
+			}
+			if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return WAITING;
+			}
+			if(n <= 0){
+				return FAILED;
+			}
+			c.pathBytes += n;
+		}
+		return DONE;
+	}
+	// Sends as much of the response as the client will take. Once all of it has been sent, the
+	// connection is ready for the next request.
+	Progress sendResponse(Connection& c){
+		size_t notesBytes = c.response.count * sizeof(mcd_note);
+		while(c.responseBytes < sizeof(c.response) + notesBytes){
+			const char* data;
+			size_t length;
+			if(c.responseBytes < sizeof(c.response)){
+				data = (const char*)&c.response + c.responseBytes;
+				length = sizeof(c.response) - c.responseBytes;
+			}else{
+				data = (const char*)c.notes->data() + (c.responseBytes - sizeof(c.response));
+				length = sizeof(c.response) + notesBytes - c.responseBytes;
+			}
+			ssize_t n = send(c.fd, data, length, MSG_NOSIGNAL);
+			if(n < 0 && errno == EINTR){
+				continue;
+			}
+			if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return WAITING;
+			}
+			if(n <= 0){
+				return FAILED;
+			}
+			c.responseBytes += n;
+		}
+		// Get ready for the next request, and let go of the note table so that its memory can be reused.
+		c.requestBytes = 0;
+		c.pathBytes = 0;
+		c.path.clear();
+		c.notes.reset();
+		c.responseBytes = 0;
+		c.sending = false;
+		return DONE;
+	}
+	// Hands the connection back to epoll to wait for the client, or closes it if that fails.
+	// The connection must not be touched afterward, because another thread may already have it.
+	void watch(int poller, Connection* c, uint32_t events){
+		epoll_event event;
+		event.events = events | EPOLLONESHOT;
+		event.data.ptr = c;
+		if(epoll_ctl(poller, EPOLL_CTL_MOD, c->fd, &event) != 0){
+			delete c;
+		}
+	}
+	// Carries on with a connection after receiving or sending some of it.
+	void carryOn(int poller, Connection* c, Progress progress){
+		if(progress == FAILED){
+			delete c;
+		}else if(progress == WAITING){
+			watch(poller, c, c->sending ? EPOLLOUT : EPOLLIN);
+		}else{
+			// A response was finished, so wait for the next request.
+			watch(poller, c, EPOLLIN);
+		}
+	}
+	// A queue of connections that have sent a whole request and are waiting for a worker. It has a
+	// fixed capacity so that the daemon stops reading requests instead of using more memory.
+	class ConnectionQueue {
+	public:
+		ConnectionQueue(size_t capacity) : capacity(capacity) {}
+		void push(Connection* c){
+			unique_lock<mutex> lock(m);
+			notFull.wait(lock, [this]{ return connections.size() < capacity; });
+			connections.push(c);
+			notEmpty.notify_one();
+		}
+		Connection* pop(){
+			unique_lock<mutex> lock(m);
+			notEmpty.wait(lock, [this]{ return !connections.empty(); });
+			Connection* c = connections.front();
+			connections.pop();
+			notFull.notify_one();
+			return c;
+		}
+	private:
+		mutex m;
+		condition_variable notEmpty;
+		condition_variable notFull;
+		size_t capacity;
+		queue<Connection*> connections;
+	};
+	// A worker answers one request at a time. The arrays that notes are decoded into are
+	// kept between requests so that they do not have to be allocated every time.
+	class Worker {
+	public:
+		Worker(NoteCache& cache) : cache(cache), pitch(BATCH), duration(BATCH), dots(BATCH), startTick(BATCH), endTick(BATCH), startUs(BATCH), endUs(BATCH) {
+			arrays = {pitch.data(), duration.data(), dots.data(), startTick.data(), endTick.data(), startUs.data(), endUs.data()};
+		}
+		// Answers the request that the connection received and starts sending the response.
+		Progress serveRequest(Connection& c){
+			NoteTable notes;
+			int status;
+			try {
+				if(c.request.type == MCD_REQUEST_PATH){
+					status = readPath(c.path, notes);
+				}else{
+					status = readFile(c.attached, notes);
+					close(c.attached);
+					c.attached = -1;
+				}
+			}catch(const bad_alloc&){
+				status = MC_ERROR_OUT_OF_MEMORY;
+			}
+			c.response.magic = MCD_MAGIC;
+			c.response.status = status;
+			c.response.count = status == MC_OK ? notes->size() : 0;
+			c.notes = move(notes);
+			c.responseBytes = 0;
+			c.sending = true;
+			return sendResponse(c);
+		}
+	private:
+		static const size_t BATCH = 4096;
+		NoteCache& cache;
+		vector<uint8_t> pitch;
+		vector<int8_t> duration;
+		vector<uint8_t> dots;
+		vector<int64_t> startTick;
+		vector<int64_t> endTick;
+		vector<int64_t> startUs;
+		vector<int64_t> endUs;
+		mc_note_arrays arrays;
+		// Reads the file at the path, using the cache if the file has not changed.
+		int readPath(const string& path, NoteTable& notes){
+			// O_NONBLOCK keeps a FIFO from blocking the worker in open(). readFile() turns it away.
+			int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+			struct stat st;
+			if(fd < 0 || fstat(fd, &st) != 0){
+				closeIfOpen(fd);
+				return MC_ERROR_IO;
+			}
+			// The key changes whenever the file is replaced or modified.
+			string key = path + '\0' +
+				to_string(st.st_dev) + ':' + to_string(st.st_ino) + ':' + to_string(st.st_size) + ':' +
+				to_string(st.st_mtim.tv_sec) + '.' + to_string(st.st_mtim.tv_nsec);
+			notes = cache.get(key);
+			int status = MC_OK;
+			if(!notes){
+				status = readFile(fd, notes);
+				if(status == MC_OK){
+					cache.put(key, notes);
+				}
+			}
+			close(fd);
+			return status;
+		}
+		// Copies the file into memory and decodes its notes. The file is never mapped, because a
+		// client that truncated a mapped file in the middle of decoding would crash the daemon with SIGBUS.
+		int readFile(int fd, NoteTable& notes){
+			struct stat st;
+			if(fstat(fd, &st) != 0){
+				return MC_ERROR_IO;
+			}
+			// Only regular files (including memfds) have a size that can be checked before reading,
+			// and reading them never waits on another process.
+			if(!S_ISREG(st.st_mode)){
+				return MC_ERROR_INVALID_ARGUMENT;
+			}
+			// The copy counts against the memory limit until it has been decoded.
+			Reservation copy(cache);
+			if(!copy.growTo(st.st_size)){
+				return MC_ERROR_OUT_OF_MEMORY;
+			}
+			vector<char> data(st.st_size);
+			size_t length = 0;
+			while(length < data.size()){
+				// pread() starts at the beginning no matter where the client left the file offset.
+				ssize_t n = pread(fd, &data[length], data.size() - length, length);
+				if(n < 0 && errno == EINTR){
+					continue;
+				}
+				if(n < 0){
+					return MC_ERROR_IO;
+				}
+				if(n == 0){
+					// The file shrank while it was being read, so decode what is there.
+					break;
+				}
+				length += n;
+			}
+			return decode(data.data(), length, notes);
+		}
+		// Decodes all of the notes in the data.
+		int decode(const char* data, size_t length, NoteTable& notes){
+			mc_reader* reader;
+			int status = mc_open_buffer(data, length, &reader);
+			if(status != MC_OK){
+				return status;
+			}
+			// The table counts against the memory limit for as long as it is alive.
+			Reservation tableMemory(cache);
+			unique_ptr<vector<mcd_note>> table(new vector<mcd_note>());
+			ptrdiff_t n;
+			while((n = mc_decode_notes(reader, &arrays, BATCH)) > 0){
+				// Grow the table by doubling, reserving the memory first.
+				size_t needed = table->size() + n;
+				if(needed > table->capacity()){
+					size_t capacity = max(needed, table->capacity() * 2);
+					if(!tableMemory.growTo(capacity * sizeof(mcd_note))){
+						status = MC_ERROR_OUT_OF_MEMORY;
+						break;
+					}
+					table->reserve(capacity);
+				}
+				for(ptrdiff_t i = 0; i < n; ++i){
+					mcd_note note;
+					memset(&note, 0, sizeof(note));
+					note.start_tick = startTick[i];
+					note.end_tick = endTick[i];
+					note.start_us = startUs[i];
+					note.end_us = endUs[i];
+					note.pitch = pitch[i];
+					note.duration = duration[i];
+					note.dots = dots[i];
+					table->push_back(note);
+				}
+			}
+			mc_close(reader);
+			if(n < 0){
+				status = n;
+			}
+			if(status != MC_OK){
+				return status;
+			}
+			notes = tableMemory.adopt(table.release());
+			return MC_OK;
+		}
+	};
+}
+int main(int argc, char** argv){
+	unsigned int numWorkers = thread::hardware_concurrency();
+	size_t memoryMegabytes = 256;
+	// Read the options.
+	int option;
+	while((option = getopt(argc, argv, "t:m:")) != -1){
+		switch(option){
+			case 't':
+				numWorkers = atoi(optarg);
+				break;
+			case 'm':
+				memoryMegabytes = atol(optarg);
+				break;
+			default:
+				return 1;
+		}
+	}
+	if(optind >= argc){
+		cout << "Music Codes Daemon by David Tsai\n"
+			<< "This program reads MIDI files for other programs over a Unix domain socket\n"
+			<< "and caches the notes of every file that it reads.\n\n"
+			<< "Options:\n"
+			<< "  -t N   Serve N clients at the same time (default: one per CPU).\n"
+			<< "  -m MB  Use up to MB megabytes for files and notes, including the cache\n"
+			<< "         (default: 256).\n\n"
+			<< "Pass in the path of the socket to listen on." << endl;
+		return 0;
+	}
+	if(strlen(argv[optind]) >= sizeof(socketPath)){
+		cerr << "The socket path is too long.\n";
+		return 1;
+	}
+	if(!numWorkers){
+		numWorkers = 1;
+	}
+	strcpy(socketPath, argv[optind]);
+	// Clients that disconnect in the middle of a response should not stop the daemon.
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, handleStopSignal);
+	signal(SIGTERM, handleStopSignal);
+	// Listen on the socket, replacing any socket left over from before.
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath);
+	unlink(socketPath);
+	if(listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0){
+		cerr << "The socket could not be opened.\n";
+		return 1;
+	}
+	// Every connection is watched by epoll with EPOLLONESHOT, so that only one thread handles it
+	// at a time. The listener is the only event without a connection.
+	int poller = epoll_create1(EPOLL_CLOEXEC);
+	epoll_event listenerEvent;
+	listenerEvent.events = EPOLLIN;
+	listenerEvent.data.ptr = NULL;
+	if(poller < 0 || epoll_ctl(poller, EPOLL_CTL_ADD, listener, &listenerEvent) != 0){
+		cerr << "The socket could not be watched.\n";
+		return 1;
+	}
+	// Start the workers.
+	NoteCache cache(memoryMegabytes << 20);
+	ConnectionQueue requests(numWorkers * 4);
+	vector<thread> workers;
+	for(unsigned int i = 0; i < numWorkers; ++i){
+		workers.emplace_back([&cache, &requests, poller]{
+			Worker worker(cache);
+			while(true){
+				Connection* c = requests.pop();
+				carryOn(poller, c, worker.serveRequest(*c));
+			}
+		});
+	}
+	// Accept new connections, collect requests, and finish sending responses.
+	epoll_event events[64];
+	while(true){
+		int n = epoll_wait(poller, events, 64, -1);
+		if(n < 0 && errno != EINTR){
+			cerr << "Connections can no longer be watched.\n";
+			break;
+		}
+		for(int i = 0; i < n; ++i){
+			Connection* c = static_cast<Connection*>(events[i].data.ptr);
+			if(c){
+				if(c->sending){
+					carryOn(poller, c, sendResponse(*c));
+					continue;
+				}
+				Progress progress = receiveRequest(*c);
+				if(progress == DONE){
+					// The whole request is here, so a worker can answer it without waiting on the client.
+					requests.push(c);
+				}else{
+					carryOn(poller, c, progress);
+				}
+				continue;
+			}
+			int client = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if(client < 0){
+				continue;
+			}
+			c = new Connection(client);
+			epoll_event clientEvent;
+			clientEvent.events = EPOLLIN | EPOLLONESHOT;
+			clientEvent.data.ptr = c;
+			if(epoll_ctl(poller, EPOLL_CTL_ADD, client, &clientEvent) != 0){
+				delete c;
+			}
+		}
+	}
+	unlink(socketPath);
+	// The workers never stop on their own.
+	_exit(1);
+}
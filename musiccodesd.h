@@ -0,0 +1,59 @@
+/*
+	The protocol spoken by musiccodesd over its Unix domain socket.
+
+	A client connects and then sends any number of requests, one at a time.
+	Every request starts with an mcd_request. For MCD_REQUEST_PATH, the path
+	follows it (without a terminating null). For MCD_REQUEST_FD, a file
+	descriptor of a regular file holding the MIDI data (such as a memfd) is
+	attached to the mcd_request with SCM_RIGHTS, and nothing follows it. The
+	data is read from the beginning of the file, and files larger than the
+	daemon's memory limit are refused with MC_ERROR_OUT_OF_MEMORY.
+
+	Every request is answered with an mcd_response. If the status is MC_OK,
+	count mcd_notes follow it. All integers are in the byte order of the
+	machine, since both ends are always on the same machine.
+*/
+#ifndef INCLUDE_MUSIC_CODES_DAEMON
+#define INCLUDE_MUSIC_CODES_DAEMON 1
+#include <stdint.h>
+#include "musiccodes.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+// "MCD1" read as a little-endian integer
+#define MCD_MAGIC 0x3144434D
+enum mcd_request_type {
+	// Read the MIDI file at a path. The notes are cached until the file changes.
+	MCD_REQUEST_PATH = 1,
+	// Read the MIDI data from the attached file descriptor. The notes are not cached.
+	MCD_REQUEST_FD = 2
+};
+typedef struct mcd_request {
+	uint32_t magic;
+	uint32_t type;
+	// The number of bytes in the path that follows, for MCD_REQUEST_PATH
+	uint32_t path_length;
+	uint32_t reserved;
+} mcd_request;
+typedef struct mcd_response {
+	uint32_t magic;
+	// One of the MC_* status codes
+	int32_t status;
+	// The number of notes that follow
+	uint64_t count;
+} mcd_response;
+// One note, with the same fields as mc_note_arrays
+typedef struct mcd_note {
+	int64_t start_tick;
+	int64_t end_tick;
+	int64_t start_us;
+	int64_t end_us;
+	uint8_t pitch;
+	int8_t duration;
+	uint8_t dots;
+	uint8_t reserved[5];
+} mcd_note;
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,101 @@
+/*
+	Render
+
+	This program plays the notes that this library reads out of a MIDI file
+	into a WAV file, so that what the parser found can be checked by ear. Each
+	note starts at its start time and lasts for its quantized duration, using
+	the tempo changes in the file.
+*/
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "MidiReader.h"
+#include "Note.h"
+#include "Renderer.h"
+using namespace std;
+using namespace MusicCodes;
+int main(int argc, char** argv){
+	unsigned int sampleRate = 44100;
+	unsigned int numThreads = thread::hardware_concurrency();
+	// Read the options.
+	int option;
+	while((option = getopt(argc, argv, "r:t:")) != -1){
+		switch(option){
+			case 'r':
+				sampleRate = atoi(optarg);
+				break;
+			case 't':
+				numThreads = atoi(optarg);
+				break;
+			default:
+				return 1;
+		}
+	}
+	// This program expects file paths to be passed in as arguments.
+	// Check whether any arguments were passed in.
+	if(optind >= argc || !sampleRate){
+		cout << "Render by David Tsai\n"
+			<< "This program plays the notes in a MIDI file into a WAV file, using the start\n"
+			<< "times and quantized durations that this library reads. The WAV file will be\n"
+			<< "placed in the same directory as the input MIDI file.\n\n"
+			<< "Options:\n"
+			<< "  -r RATE  The sample rate in hertz (default: 44100).\n"
+			<< "  -t N     Render on N threads (default: one per CPU).\n\n"
+			<< "Pass in one or more paths to MIDI files." << endl;
+		return 0;
+	}
+	// Loop through the arguments.
+	int numFailures = 0;
+	for(int i = optind; i < argc; ++i){
+		// Print out the argument so that the user knows which one is being processed.
+		if(argc - optind > 1){
+			if(i > optind){
+				cout << '\n';
+			}
+			cout << "File: " << argv[i] << endl;
+		}
+		// Open the file.
+		ifstream midifile(argv[i]);
+		if(!midifile){
+			cerr << "This file could not be opened.\n";
+			++numFailures;
+			continue;
+		}
+		// Read the MIDI data.
+		MidiReader midiread(midifile);
+		if(!midiread){
+			cerr << "This is not a supported MIDI file.\n";
+			++numFailures;
+			continue;
+		}
+		vector<Note> notes;
+		Note n = Note::InvalidNote();
+		while((n = midiread.getNextNote())){
+			// Replace the end of the note with the end of its quantized duration, using the tempo that it was
+			// quantized with. This is done right away because multi-song files start a new tempo map for every song.
+			int64_t endTick = n.getQuantizedEndTick(midiread.getTicksPerQuarterNoteAt(n.getEndTick()));
+			notes.emplace_back(n.getPitch(), n.getDuration(), n.getDots(), n.getStartTick(), endTick, n.getStartMicroseconds(), midiread.ticksToMicroseconds(endTick));
+		}
+		size_t numNotes = notes.size();
+		auto start = chrono::steady_clock::now();
+		Renderer renderer(move(notes), sampleRate);
+		vector<float> samples = renderer.render(numThreads);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		// Create a new WAV file.
+		ofstream wav(string(argv[i]) + ".wav", ios::binary);
+		if(!wav || !renderer.writeWav(wav, samples)){
+			cerr << "The output file could not be written.\n";
+			++numFailures;
+			continue;
+		}
+		double soundSeconds = (double)samples.size() / sampleRate;
+		cout << "Rendered " << numNotes << " notes into " << soundSeconds << " seconds of sound in " << seconds
+			<< " seconds (" << (seconds > 0 ? soundSeconds / seconds : 0) << " times real time)." << endl;
+	}
+	return numFailures;
+}